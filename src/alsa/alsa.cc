@@ -30,25 +30,30 @@
  * however, it will be sitting in poll() waiting for ALSA's signal that more
  * data can be written.
  *
- * * After adding more data to the buffer, and after resuming from pause,
- *   signal on alsa_cond to wake the pump.  (There is no need to signal when
- *   entering pause.)
+ * The buffer itself is lock-free, so write_audio() does not take the mutex.
+ *
+ * * After adding more data to the buffer, signal on alsa_cond if pump_waiting
+ *   is set, and after resuming from pause, signal on alsa_cond, to wake the
+ *   pump.  (There is no need to signal when entering pause.)
  * * After setting the pump_quit flag, signal on alsa_cond AND the poll_pipe
  *   before joining the thread.
  */
 
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <poll.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdint.h>
 #include <time.h>
 #include <unistd.h>
 
 #include <alsa/asoundlib.h>
-#include <libaudcore/ringbuf.h>
+#include <libaudcore/mainloop.h>
 
 #include "alsa.h"
+#include "../dsp-common/spsc-ring.h"
 
 EXPORT ALSAPlugin aud_plugin_instance;
 
@@ -56,6 +61,7 @@ EXPORT ALSAPlugin aud_plugin_instance;
 do { \
     (value) = function (__VA_ARGS__); \
     if ((value) < 0) { \
+        note_error (value); \
         CHECK (snd_pcm_recover, alsa_handle, (value), 0); \
         CHECK_VAL ((value), function, __VA_ARGS__); \
     } \
@@ -67,6 +73,16 @@ do { \
     CHECK_VAL_RECOVER (CHECK_RECOVER_error, function, __VA_ARGS__); \
 } while (0)
 
+/* In adaptive mode, the hardware buffer is ADAPTIVE_PERIODS periods long.  The
+ * period starts at ADAPTIVE_MIN_PERIOD and is doubled, for the device in use,
+ * after ADAPTIVE_UNDERRUNS underruns that were the pump's fault. */
+#define ADAPTIVE_PERIODS 4
+#define ADAPTIVE_MIN_PERIOD 5 /* milliseconds */
+#define ADAPTIVE_MAX_PERIOD 80 /* milliseconds */
+#define ADAPTIVE_UNDERRUNS 2
+
+#define REALTIME_PRIORITY 10
+
 static snd_pcm_t * alsa_handle;
 static pthread_mutex_t alsa_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t alsa_cond = PTHREAD_COND_INITIALIZER;
@@ -74,9 +90,19 @@ static pthread_cond_t alsa_cond = PTHREAD_COND_INITIALIZER;
 static snd_pcm_format_t alsa_format;
 static int alsa_channels, alsa_rate;
 
-static RingBuf<char> alsa_buffer;
+static SpscRing<char> alsa_buffer;
 static int alsa_period; /* milliseconds */
 
+static bool alsa_mmap;
+
+static String alsa_pcm;
+static int alsa_hw_frames;
+static bool alsa_adaptive, alsa_realtime;
+static int alsa_underruns; /* since opened */
+static int alsa_hw_fill; /* frames in the hardware buffer, -1 if not known */
+static int alsa_min_fill; /* likewise, the lowest since opened */
+static QueuedFunc reopen_func;
+
 static bool alsa_prebuffer, alsa_paused;
 static int alsa_paused_delay; /* milliseconds */
 
@@ -85,6 +111,7 @@ static int poll_count;
 static pollfd * poll_handles;
 
 static bool pump_quit;
+static bool pump_waiting;  /* set while waiting for data */
 static pthread_t pump_thread;
 
 static snd_mixer_t * alsa_mixer;
@@ -146,8 +173,106 @@ static void poll_cleanup ()
     delete[] poll_handles;
 }
 
+/* The period used in adaptive mode is kept for each device. */
+static StringBuf period_key (const char * pcm)
+{
+    StringBuf key = str_concat ({"adaptive-period-", pcm});
+
+    for (char * c = key; * c; c ++)
+    {
+        if (! isalnum (* c) && * c != '-')
+            * c = '_';
+    }
+
+    return key;
+}
+
+static void reopen_cb (void *)
+{
+    aud_output_reset (OutputReset::ReopenStream);
+}
+
+static void grow_period ()
+{
+    int period = aud::min (alsa_period * 2, ADAPTIVE_MAX_PERIOD);
+
+    if (period <= alsa_period)
+        return;
+
+    AUDINFO ("Increasing period to %d ms for %s.\n", period, (const char *) alsa_pcm);
+    aud_set_int ("alsa", period_key (alsa_pcm), period);
+
+    reopen_func.queue (reopen_cb, nullptr);
+}
+
+/* Called with the mutex locked when an ALSA call has failed, before trying to
+ * recover.  An underrun with nothing in the ring buffer just means that the
+ * decoder did not keep up, or that the song is over, so only those with audio
+ * waiting count against the hardware buffer size. */
+static void note_error (int error)
+{
+    if (error != -EPIPE)
+        return;
+
+    if (! alsa_buffer.len ())
+    {
+        AUDDBG ("Underrun with empty buffer.\n");
+        return;
+    }
+
+    alsa_underruns ++;
+
+    AUDWARN ("Underrun (%d since opened) with buffer %d%% full.\n",
+     alsa_underruns, (int) ((int64_t) alsa_buffer.len () * 100 / alsa_buffer.size ()));
+
+    if (alsa_adaptive && alsa_underruns == ADAPTIVE_UNDERRUNS)
+        grow_period ();
+}
+
+static void set_realtime ()
+{
+    sched_param param = sched_param ();
+    param.sched_priority = REALTIME_PRIORITY;
+
+    int error = pthread_setschedparam (pthread_self (), SCHED_FIFO, & param);
+    if (error)
+        AUDWARN ("Failed to set real-time priority: %s.\n", strerror (error));
+}
+
+/* Copies straight from the ring buffer into the memory-mapped buffer of the
+ * device, saving the copy that snd_pcm_writei() makes.  Fewer frames may be
+ * written than asked for if the device buffer wraps around. */
+static snd_pcm_sframes_t mmap_write (const void * data, snd_pcm_uframes_t frames)
+{
+    const snd_pcm_channel_area_t * areas;
+    snd_pcm_uframes_t offset;
+
+    int error = snd_pcm_mmap_begin (alsa_handle, & areas, & offset, & frames);
+    if (error < 0)
+        return error;
+
+    /* interleaved, so a single area holds all the channels */
+    char * dest = (char *) areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+    memcpy (dest, data, snd_pcm_frames_to_bytes (alsa_handle, frames));
+
+    snd_pcm_sframes_t written = snd_pcm_mmap_commit (alsa_handle, offset, frames);
+
+    /* unlike snd_pcm_writei(), committing does not start the device */
+    if (written > 0 && snd_pcm_state (alsa_handle) == SND_PCM_STATE_PREPARED)
+    {
+        error = snd_pcm_start (alsa_handle);
+        if (error < 0)
+            return error;
+    }
+
+    return written;
+}
+
 static void * pump (void *)
 {
+    if (alsa_realtime)
+        set_realtime ();
+
     pthread_mutex_lock (& alsa_mutex);
     pthread_cond_broadcast (& alsa_cond); /* signal thread started */
 
@@ -157,24 +282,47 @@ static void * pump (void *)
 
     while (! pump_quit)
     {
-        int writable = snd_pcm_bytes_to_frames (alsa_handle, alsa_buffer.linear ());
+        char * data;
+        int writable = snd_pcm_bytes_to_frames (alsa_handle, alsa_buffer.peek (data));
 
         if (alsa_prebuffer || alsa_paused || ! writable)
         {
-            pthread_cond_wait (& alsa_cond, & alsa_mutex);
+            /* write_audio() only signals if it sees this flag, so look at the
+             * buffer once more after setting it */
+            __atomic_store_n (& pump_waiting, true, __ATOMIC_SEQ_CST);
+            __atomic_thread_fence (__ATOMIC_SEQ_CST);
+
+            if (alsa_prebuffer || alsa_paused || ! alsa_buffer.len ())
+                pthread_cond_wait (& alsa_cond, & alsa_mutex);
+
+            __atomic_store_n (& pump_waiting, false, __ATOMIC_RELAXED);
             continue;
         }
 
         int avail;
         CHECK_VAL_RECOVER (avail, snd_pcm_avail_update, alsa_handle);
 
+        if (snd_pcm_state (alsa_handle) == SND_PCM_STATE_RUNNING)
+        {
+            int fill = alsa_hw_frames - avail;
+            if (alsa_min_fill < 0 || fill < alsa_min_fill)
+                alsa_min_fill = fill;
+
+            alsa_hw_fill = fill;
+        }
+
         if (avail)
         {
             wakeups_since_write = 0;
 
             int written;
-            CHECK_VAL_RECOVER (written, snd_pcm_writei, alsa_handle,
-             & alsa_buffer[0], aud::min (writable, avail));
+
+            if (alsa_mmap)
+                CHECK_VAL_RECOVER (written, mmap_write, data,
+                 aud::min (writable, avail));
+            else
+                CHECK_VAL_RECOVER (written, snd_pcm_writei, alsa_handle,
+                 data, aud::min (writable, avail));
 
             failed_once = false;
 
@@ -182,7 +330,7 @@ static void * pump (void *)
 
             pthread_cond_broadcast (& alsa_cond); /* signal write complete */
 
-            if (writable < avail)
+            if (written < avail)
                 continue;
         }
 
@@ -269,6 +417,7 @@ bool ALSAPlugin::init ()
 void ALSAPlugin::cleanup ()
 {
     AUDDBG ("Cleanup.\n");
+    reopen_func.stop ();
     close_mixer ();
 }
 
@@ -337,8 +486,19 @@ bool ALSAPlugin::open_audio (int aud_format, int rate, int channels, String & er
     snd_pcm_hw_params_t * params;
     snd_pcm_hw_params_alloca (& params);
     CHECK_STR (error, snd_pcm_hw_params_any, alsa_handle, params);
-    CHECK_STR (error, snd_pcm_hw_params_set_access, alsa_handle, params,
-     SND_PCM_ACCESS_RW_INTERLEAVED);
+
+    alsa_mmap = aud_get_bool ("alsa", "mmap");
+
+    if (alsa_mmap && snd_pcm_hw_params_set_access (alsa_handle, params,
+     SND_PCM_ACCESS_MMAP_INTERLEAVED) < 0)
+    {
+        AUDINFO ("Memory-mapped access not supported; using read/write access.\n");
+        alsa_mmap = false;
+    }
+
+    if (! alsa_mmap)
+        CHECK_STR (error, snd_pcm_hw_params_set_access, alsa_handle, params,
+         SND_PCM_ACCESS_RW_INTERLEAVED);
 
     CHECK_STR (error, snd_pcm_hw_params_set_format, alsa_handle, params, format);
     CHECK_STR (error, snd_pcm_hw_params_set_channels, alsa_handle, params, channels);
@@ -348,8 +508,21 @@ bool ALSAPlugin::open_audio (int aud_format, int rate, int channels, String & er
     alsa_channels = channels;
     alsa_rate = rate;
 
+    alsa_pcm = pcm;
+    alsa_adaptive = aud_get_bool ("alsa", "adaptive");
+    alsa_realtime = aud_get_bool ("alsa", "realtime");
+
     total_buffer = aud_get_int (nullptr, "output_buffer_size");
-    useconds = 1000 * aud::min (1000, total_buffer / 2);
+
+    if (alsa_adaptive)
+    {
+        int period = aud::clamp (aud_get_int ("alsa", period_key (pcm)),
+         ADAPTIVE_MIN_PERIOD, ADAPTIVE_MAX_PERIOD);
+        useconds = 1000 * ADAPTIVE_PERIODS * period;
+    }
+    else
+        useconds = 1000 * aud::min (1000, total_buffer / 2);
+
     direction = 0;
     CHECK_STR (error, snd_pcm_hw_params_set_buffer_time_near, alsa_handle,
      params, & useconds, & direction);
@@ -363,6 +536,10 @@ bool ALSAPlugin::open_audio (int aud_format, int rate, int channels, String & er
 
     CHECK_STR (error, snd_pcm_hw_params, alsa_handle, params);
 
+    snd_pcm_uframes_t hw_frames;
+    CHECK_STR (error, snd_pcm_hw_params_get_buffer_size, params, & hw_frames);
+    alsa_hw_frames = hw_frames;
+
     soft_buffer = aud::max (total_buffer / 2, total_buffer - hard_buffer);
     AUDINFO ("Buffer: hardware %d ms, software %d ms, period %d ms.\n",
      hard_buffer, soft_buffer, alsa_period);
@@ -374,6 +551,9 @@ bool ALSAPlugin::open_audio (int aud_format, int rate, int channels, String & er
     alsa_paused = false;
     alsa_paused_delay = 0;
 
+    alsa_underruns = 0;
+    alsa_hw_fill = alsa_min_fill = -1;
+
     if (! poll_setup ())
         goto FAILED;
 
@@ -401,6 +581,11 @@ void ALSAPlugin::close_audio ()
     assert (alsa_handle);
 
     pump_stop ();
+
+    if (alsa_min_fill >= 0)
+        AUDINFO ("%d underruns; lowest hardware buffer fill level %d ms.\n",
+         alsa_underruns, aud::rescale (alsa_min_fill, alsa_rate, 1000));
+
     CHECK (snd_pcm_drop, alsa_handle);
 
 FAILED:
@@ -412,17 +597,47 @@ FAILED:
     pthread_mutex_unlock (& alsa_mutex);
 }
 
-int ALSAPlugin::write_audio (const void * data, int length)
+String ALSAPlugin::get_stats ()
 {
     pthread_mutex_lock (& alsa_mutex);
 
-    length = aud::min (length, alsa_buffer.space ());
-    alsa_buffer.copy_in ((const char *) data, length);
+    String stats;
 
-    if (! alsa_paused)
-        pthread_cond_broadcast (& alsa_cond);
+    if (! alsa_handle)
+        stats = String (_("No audio is being played."));
+    else
+    {
+        int sw_fill = snd_pcm_bytes_to_frames (alsa_handle, alsa_buffer.len ());
+        int sw_frames = snd_pcm_bytes_to_frames (alsa_handle, alsa_buffer.size ());
+
+        auto ms = [] (int frames)
+            { return (frames < 0) ? -1 : aud::rescale (frames, alsa_rate, 1000); };
+
+        stats = String (str_printf (_("Underruns: %d\n"
+         "Hardware buffer: %d of %d ms (lowest %d ms)\n"
+         "Software buffer: %d of %d ms"), alsa_underruns,
+         ms (alsa_hw_fill), ms (alsa_hw_frames), ms (alsa_min_fill),
+         ms (sw_fill), ms (sw_frames)));
+    }
 
     pthread_mutex_unlock (& alsa_mutex);
+    return stats;
+}
+
+int ALSAPlugin::write_audio (const void * data, int length)
+{
+    /* the buffer is not locked; the pump thread is only woken if it has run
+     * out of data and gone to sleep */
+    length = alsa_buffer.write ((const char *) data, length);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n (& pump_waiting, __ATOMIC_SEQ_CST))
+    {
+        pthread_mutex_lock (& alsa_mutex);
+        pthread_cond_broadcast (& alsa_cond);
+        pthread_mutex_unlock (& alsa_mutex);
+    }
+
     return length;
 }
 
@@ -498,7 +713,7 @@ void ALSAPlugin::flush ()
     CHECK (snd_pcm_drop, alsa_handle);
 
 FAILED:
-    alsa_buffer.discard ();
+    alsa_buffer.flush ();
 
     alsa_prebuffer = true;
     alsa_paused_delay = 0;
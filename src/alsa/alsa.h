@@ -87,6 +87,9 @@ public:
     void pause (bool pause);
     void flush ();
 
+    /* underruns and fill levels of the open stream, for display */
+    static String get_stats ();
+
 private:
     static void open_mixer ();
     static void close_mixer ();
@@ -17,6 +17,8 @@
  * the use of this software.
  */
 
+#include <stdio.h>
+
 #include <alsa/asoundlib.h>
 
 #include <libaudcore/hook.h>
@@ -241,6 +243,9 @@ static void guess_element ()
 const char * const ALSAPlugin::defaults[] = {
     "pcm", "default",
     "mixer", "default",
+    "mmap", "FALSE",
+    "adaptive", "FALSE",
+    "realtime", "FALSE",
     nullptr
 };
 
@@ -285,6 +290,8 @@ void ALSAPlugin::element_changed ()
     open_mixer ();
 }
 
+static char stats_text[256];
+
 static ArrayRef<ComboItem> pcm_combo_fill ()
     { return {pcm_combo_items.begin (), pcm_combo_items.len ()}; }
 static ArrayRef<ComboItem> mixer_combo_fill ()
@@ -301,7 +308,15 @@ const PreferencesWidget ALSAPlugin::widgets[] = {
         {nullptr, mixer_combo_fill}),
     WidgetCombo (N_("Mixer element:"),
         WidgetString ("alsa", "mixer-element", element_changed, "alsa mixer changed"),
-        {nullptr, element_combo_fill})
+        {nullptr, element_combo_fill}),
+    WidgetCheck (N_("Use memory-mapped transfers"),
+        WidgetBool ("alsa", "mmap", pcm_changed)),
+    WidgetCheck (N_("Adapt buffer size to underruns"),
+        WidgetBool ("alsa", "adaptive", pcm_changed)),
+    WidgetCheck (N_("Use real-time scheduling"),
+        WidgetBool ("alsa", "realtime", pcm_changed)),
+    WidgetLabel (N_("<b>Statistics</b>")),
+    WidgetLabel (stats_text)
 };
 
 static void alsa_prefs_init ()
@@ -309,6 +324,10 @@ static void alsa_prefs_init ()
     pcm_list_fill ();
     mixer_list_fill ();
     element_list_fill ();
+
+    /* as of when the settings are opened */
+    String stats = ALSAPlugin::get_stats ();
+    snprintf (stats_text, sizeof stats_text, "%s", (const char *) stats);
 }
 
 static void alsa_prefs_cleanup ()
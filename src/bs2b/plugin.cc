@@ -27,6 +27,8 @@
 
 #include <bs2b.h>
 
+#include "../dsp-common/cached-setting.h"
+
 class BS2BPlugin : public EffectPlugin
 {
 public:
@@ -55,6 +57,28 @@ EXPORT BS2BPlugin aud_plugin_instance;
 static t_bs2bdp bs2b = nullptr;
 static int bs2b_channels;
 
+/* changed by the main thread, applied by the audio thread */
+static CachedSetting<int> feed_level ("bs2b", "feed");
+static CachedSetting<int> fcut_level ("bs2b", "fcut");
+static int applied_feed, applied_fcut;
+
+static void reload_levels (void *, void *)
+{
+    feed_level.update ();
+    fcut_level.update ();
+}
+
+static void apply_levels ()
+{
+    int new_feed = feed_level.get ();
+    int new_fcut = fcut_level.get ();
+
+    if (new_feed != applied_feed)
+        bs2b_set_level_feed (bs2b, (applied_feed = new_feed));
+    if (new_fcut != applied_fcut)
+        bs2b_set_level_fcut (bs2b, (applied_fcut = new_fcut));
+}
+
 const char * const BS2BPlugin::defaults[] = {
  "feed", "45",
  "fcut", "700",
@@ -68,14 +92,21 @@ bool BS2BPlugin::init ()
     if (! bs2b)
         return false;
 
-    bs2b_set_level_feed (bs2b, aud_get_int ("bs2b", "feed"));
-    bs2b_set_level_fcut (bs2b, aud_get_int ("bs2b", "fcut"));
+    feed_level.update ();
+    fcut_level.update ();
+
+    applied_feed = applied_fcut = 0;
+    apply_levels ();
+
+    hook_associate ("bs2b settings changed", reload_levels, nullptr);
 
     return true;
 }
 
 void BS2BPlugin::cleanup ()
 {
+    hook_dissociate ("bs2b settings changed", reload_levels);
+
     bs2b_close (bs2b);
     bs2b = nullptr;
 }
@@ -89,19 +120,18 @@ void BS2BPlugin::start (int & channels, int & rate)
 Index<float> & BS2BPlugin::process (Index<float> & data)
 {
     if (bs2b_channels == 2)
+    {
+        apply_levels ();
         bs2b_cross_feed_f (bs2b, data.begin (), data.len () / 2);
+    }
 
     return data;
 }
 
-static void feed_value_changed ()
+/* the levels are shared with the Stereo Effects plugin */
+static void levels_changed ()
 {
-    bs2b_set_level_feed (bs2b, aud_get_int ("bs2b", "feed"));
-}
-
-static void fcut_value_changed ()
-{
-    bs2b_set_level_fcut (bs2b, aud_get_int ("bs2b", "fcut"));
+    hook_call ("bs2b settings changed", nullptr);
 }
 
 static void set_preset (uint32_t preset)
@@ -112,9 +142,7 @@ static void set_preset (uint32_t preset)
     aud_set_int ("bs2b", "feed", feed);
     aud_set_int ("bs2b", "fcut", fcut);
 
-    bs2b_set_level_feed (bs2b, feed);
-    bs2b_set_level_fcut (bs2b, fcut);
-
+    levels_changed ();
     hook_call ("bs2b preset loaded", nullptr);
 }
 
@@ -134,10 +162,10 @@ static const PreferencesWidget preset_widgets[] = {
 
 const PreferencesWidget BS2BPlugin::widgets[] = {
     WidgetSpin (N_("Feed level:"),
-        WidgetInt ("bs2b", "feed", feed_value_changed, "bs2b preset loaded"),
+        WidgetInt ("bs2b", "feed", levels_changed, "bs2b preset loaded"),
         {BS2B_MINFEED, BS2B_MAXFEED, 1, N_("x1/10 dB")}),
     WidgetSpin (N_("Cut frequency:"),
-        WidgetInt ("bs2b", "fcut", fcut_value_changed, "bs2b preset loaded"),
+        WidgetInt ("bs2b", "fcut", levels_changed, "bs2b preset loaded"),
         {BS2B_MINFCUT, BS2B_MAXFCUT, 1, N_("Hz")}),
     WidgetBox ({{preset_widgets}, true})
 };
@@ -28,27 +28,51 @@
 #include <libaudcore/ringbuf.h>
 #include <libaudcore/runtime.h>
 
+#include "../dsp-common/cached-setting.h"
+#include "../dsp-common/simd.h"
+#include "../dsp-common/sliding-max.h"
+
 /* Response time adjustments.  Maybe this should be adjustable? */
 #define CHUNK_TIME 0.2f /* seconds */
 #define CHUNKS 5
 #define DECAY 0.3f
 
+/* In look-ahead mode, the gain is recomputed every LOOKAHEAD_BLOCK frames and
+ * ramped linearly in between. */
+#define LOOKAHEAD_BLOCK 32
+
 /* What is a "normal" volume?  Replay Gain stuff claims to use 89 dB, but what
  * does that translate to in our PCM range? */
 static const char * const compressor_defaults[] = {
     "center", "0.5",
     "range", "0.5",
+    "lookahead", "FALSE",
+    "lookahead_time", "20",
+    "release_time", "200",
      nullptr
 };
 
+static void settings_changed ();
+
 static const PreferencesWidget compressor_widgets[] = {
     WidgetLabel (N_("<b>Compression</b>")),
     WidgetSpin (N_("Center volume:"),
-        WidgetFloat ("compressor", "center"),
+        WidgetFloat ("compressor", "center", settings_changed),
         {0.1, 1, 0.1}),
     WidgetSpin (N_("Dynamic range:"),
-        WidgetFloat ("compressor", "range"),
-        {0.0, 3.0, 0.1})
+        WidgetFloat ("compressor", "range", settings_changed),
+        {0.0, 3.0, 0.1}),
+    WidgetLabel (N_("<b>Look-ahead</b>")),
+    WidgetCheck (N_("Detect peaks ahead of playback (adds latency)"),
+        WidgetBool ("compressor", "lookahead")),
+    WidgetSpin (N_("Look-ahead time:"),
+        WidgetInt ("compressor", "lookahead_time"),
+        {1, 100, 1, N_("ms")}, WIDGET_CHILD),
+    WidgetSpin (N_("Release time:"),
+        WidgetInt ("compressor", "release_time", settings_changed),
+        {10, 2000, 10, N_("ms")}, WIDGET_CHILD),
+    WidgetLabel (N_("Changes to look-ahead take effect at the next song."),
+        WIDGET_CHILD)
 };
 
 static const PluginPreferences compressor_prefs = {{compressor_widgets}};
@@ -92,6 +116,25 @@ static int chunk_size;
 static float current_peak;
 static int current_channels, current_rate;
 
+static CachedSetting<float> center ("compressor", "center");
+static CachedSetting<float> range ("compressor", "range");
+static CachedSetting<int> release_time ("compressor", "release_time");
+
+/* Look-ahead state.  The ring buffer holds lookahead_frames of delay plus the
+ * block being filled; the sliding maximum covers the same span, so the gain
+ * ramp applied to a block has already seen every peak in it. */
+static bool lookahead_mode;
+static int lookahead_frames, block_fill;
+static float current_gain, release_coef, attack_coef;
+static SlidingMax peak_window;
+
+static void settings_changed ()
+{
+    center.update ();
+    range.update ();
+    release_time.update ();
+}
+
 /* I used to find the maximum sample and take that as the peak, but that doesn't
  * work well on badly clipped tracks.  Now, I use the highly sophisticated
  * method of averaging the absolute value of the samples and multiplying by 6, a
@@ -111,10 +154,8 @@ static float calc_peak (float * data, int length)
 
 static void do_ramp (float * data, int length, float peak_a, float peak_b)
 {
-    float center = aud_get_double ("compressor", "center");
-    float range = aud_get_double ("compressor", "range");
-    float a = powf (peak_a / center, range - 1);
-    float b = powf (peak_b / center, range - 1);
+    float a = powf (peak_a / center.get (), range.get () - 1);
+    float b = powf (peak_b / center.get (), range.get () - 1);
 
     for (int count = 0; count < length; count ++)
     {
@@ -123,9 +164,82 @@ static void do_ramp (float * data, int length, float peak_a, float peak_b)
     }
 }
 
+static float calc_gain (float peak)
+{
+    return powf (aud::max (0.01f, peak) / center.get (), range.get () - 1);
+}
+
+/* Applies a gain ramp to the first <samples> samples of the ring buffer, which
+ * may wrap around its end. */
+static void ramp_buffer (int samples, float gain_a, float gain_b)
+{
+    float step = (gain_b - gain_a) / samples;
+    int linear = aud::min (samples, buffer.linear ());
+
+    simd_ramp (& buffer[0], linear, gain_a, step);
+
+    if (linear < samples)
+        simd_ramp (& buffer[linear], samples - linear, gain_a + step * linear, step);
+}
+
+static void lookahead_block ()
+{
+    float target = calc_gain (peak_window.max ());
+
+    if (current_gain < 0.0f)
+        current_gain = target;
+
+    /* attack fast enough to settle within the look-ahead time, release slowly */
+    float coef = (target < current_gain) ? attack_coef : release_coef;
+    float new_gain = current_gain + (target - current_gain) * coef;
+
+    int samples = LOOKAHEAD_BLOCK * current_channels;
+    ramp_buffer (samples, current_gain, new_gain);
+    buffer.move_out (output, -1, samples);
+
+    current_gain = new_gain;
+}
+
+static void lookahead_process (Index<float> & data)
+{
+    const float * in = data.begin ();
+    const float * end = data.end ();
+
+    float release = release_time.get () * 0.001f * current_rate;
+    release_coef = 1.0f - expf (-LOOKAHEAD_BLOCK / release);
+
+    while (in < end)
+    {
+        int frames = aud::min ((int) (end - in) / current_channels,
+         LOOKAHEAD_BLOCK - block_fill);
+
+        buffer.copy_in (in, frames * current_channels);
+
+        for (int f = 0; f < frames; f ++)
+        {
+            float peak = 0;
+            for (int c = 0; c < current_channels; c ++)
+                peak = aud::max (peak, fabsf (in[c]));
+
+            peak_window.push (peak);
+            in += current_channels;
+        }
+
+        block_fill += frames;
+        if (block_fill < LOOKAHEAD_BLOCK)
+            break;
+
+        block_fill = 0;
+
+        if (buffer.len () == buffer.size ())
+            lookahead_block ();
+    }
+}
+
 bool Compressor::init ()
 {
     aud_config_set_defaults ("compressor", compressor_defaults);
+    settings_changed ();
     return true;
 }
 
@@ -141,10 +255,28 @@ void Compressor::start (int & channels, int & rate)
     current_channels = channels;
     current_rate = rate;
 
-    chunk_size = channels * (int) (rate * CHUNK_TIME);
+    lookahead_mode = aud_get_bool ("compressor", "lookahead");
+
+    if (lookahead_mode)
+    {
+        /* round the look-ahead up to whole blocks */
+        int frames = aud::rescale (aud_get_int ("compressor", "lookahead_time"), 1000, rate);
+        int blocks = aud::max (1, (frames + LOOKAHEAD_BLOCK - 1) / LOOKAHEAD_BLOCK);
 
-    buffer.alloc (chunk_size * CHUNKS);
-    peaks.alloc (CHUNKS);
+        lookahead_frames = blocks * LOOKAHEAD_BLOCK;
+        attack_coef = 1.0f - expf (-4.6f / blocks);  /* 99% in look-ahead time */
+
+        buffer.alloc ((lookahead_frames + LOOKAHEAD_BLOCK) * channels);
+        peak_window.resize (lookahead_frames + LOOKAHEAD_BLOCK);
+        peaks.destroy ();
+    }
+    else
+    {
+        chunk_size = channels * (int) (rate * CHUNK_TIME);
+
+        buffer.alloc (chunk_size * CHUNKS);
+        peaks.alloc (CHUNKS);
+    }
 
     flush (true);
 }
@@ -153,6 +285,12 @@ Index<float> & Compressor::process (Index<float> & data)
 {
     output.resize (0);
 
+    if (lookahead_mode)
+    {
+        lookahead_process (data);
+        return output;
+    }
+
     int offset = 0;
     int remain = data.len ();
 
@@ -199,6 +337,11 @@ bool Compressor::flush (bool force)
     peaks.discard ();
 
     current_peak = 0.0f;
+
+    peak_window.reset ();
+    block_fill = 0;
+    current_gain = -1.0f;
+
     return true;
 }
 
@@ -206,6 +349,24 @@ Index<float> & Compressor::finish (Index<float> & data, bool end_of_playlist)
 {
     output.resize (0);
 
+    if (lookahead_mode)
+    {
+        /* the remaining audio has no future to look at, so hold the gain */
+        lookahead_process (data);
+
+        if (current_gain < 0.0f && buffer.len ())
+            current_gain = calc_gain (peak_window.max ());
+
+        while (buffer.len ())
+        {
+            int writable = buffer.linear ();
+            simd_ramp (& buffer[0], writable, current_gain, 0.0f);
+            buffer.move_out (output, -1, writable);
+        }
+
+        return output;
+    }
+
     peaks.discard ();
 
     while (buffer.len ())
@@ -0,0 +1,768 @@
+/*
+ * Convolution effect plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <samplerate.h>
+#include <sndfile.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/i18n.h>
+#include <libaudcore/mainloop.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+#include <libaudcore/runtime.h>
+
+#include "../dsp-common/cached-setting.h"
+#include "../dsp-common/fft.h"
+#include "../dsp-common/simd.h"
+
+/* The impulse response is applied by uniformly partitioned convolution in the
+ * frequency domain (overlap-save).  Each block of input is transformed once and
+ * kept in a delay line of spectra; each output block is the sum of the
+ * products of these spectra with those of the matching partitions of the
+ * impulse response, transformed back.  The cost per sample grows with the
+ * number of partitions instead of the number of taps.
+ *
+ * Short partitions keep the latency low but make long responses expensive, so
+ * two sizes are used.  The first TAIL_BLOCK taps (the head) are done in blocks
+ * of HEAD_BLOCK frames, which is the whole latency.  The rest (the tail) is
+ * done in blocks of TAIL_BLOCK frames; being delayed by TAIL_BLOCK taps, its
+ * output is needed only once the block after the one it was computed from
+ * begins, so the longer blocks add no latency. */
+
+#define HEAD_BLOCK 64
+#define TAIL_BLOCK 1024
+
+#define MAX_IR_SECONDS 30
+#define IR_SILENCE 1e-6f  /* -120 dB; trailing samples below this are dropped */
+
+#define CFGSECT "convolver"
+
+class Convolver : public EffectPlugin
+{
+public:
+    static const char * const defaults[];
+    static const PreferencesWidget widgets[];
+    static const PluginPreferences prefs;
+
+    static constexpr PluginInfo info = {
+        N_("Convolver"),
+        PACKAGE,
+        nullptr,
+        & prefs
+    };
+
+    /* after the channel mixer and resampler, so that the impulse responses
+     * match the channels and rate that are actually played */
+    constexpr Convolver () : EffectPlugin (info, 3, true) {}
+
+    bool init ();
+    void cleanup ();
+
+    void start (int & channels, int & rate);
+    Index<float> & process (Index<float> & data);
+    bool flush (bool force);
+    Index<float> & finish (Index<float> & data, bool end_of_playlist);
+    int adjust_delay (int delay);
+};
+
+EXPORT Convolver aud_plugin_instance;
+
+struct ImpulseResponse
+{
+    int channels, rate;
+    Index<float> data;  /* interleaved */
+};
+
+/* Convolves each channel with its own impulse response, one block at a time.
+ * Pairs of channels share a complex transform, one as its real part and the
+ * other as its imaginary part. */
+class PartitionedConvolver
+{
+public:
+    /* Uses taps [offset, offset + length) of the impulse response, which has
+     * <ir_channels> interleaved channels.  Channel c is convolved with channel
+     * c of the response, or the only one if there is only one. */
+    void init (int channels, int block, const Index<float> & ir, int ir_channels,
+     int offset, int length);
+    void clear ();
+
+    /* the next block of input is written here */
+    float * input (int c)
+        { return & m_input[(2 * c + 1) * m_block]; }
+
+    /* and the corresponding block of output is found here after run() */
+    float * output (int c)
+        { return & m_output[c * m_block]; }
+
+    void run ();
+
+private:
+    FFT::Complex * spectrum (Index<FFT::Complex> & list, int c, int part)
+        { return & list[(c * m_parts + part) * (m_block + 1)]; }
+
+    int m_channels = 0, m_block = 0, m_parts = 0;
+    int m_pos = 0;  /* slot of the newest spectrum in the delay line */
+
+    FFT m_fft;
+    Index<FFT::Complex> m_filter, m_delay_line, m_acc, m_buf;
+    Index<float> m_input, m_output;
+};
+
+void PartitionedConvolver::init (int channels, int block, const Index<float> & ir,
+ int ir_channels, int offset, int length)
+{
+    int size = 2 * block;
+    int bins = block + 1;
+
+    m_channels = channels;
+    m_block = block;
+    m_parts = (length + block - 1) / block;
+
+    m_fft.init (size);
+    m_buf.resize (size);
+
+    m_filter.resize (0);
+    m_filter.insert (0, channels * m_parts * bins);
+    m_delay_line.resize (0);
+    m_delay_line.insert (0, channels * m_parts * bins);
+    m_acc.resize (0);
+    m_acc.insert (0, 2 * bins);
+    m_input.resize (0);
+    m_input.insert (0, channels * size);
+    m_output.resize (0);
+    m_output.insert (0, channels * block);
+    m_pos = 0;
+
+    /* Scaled down by the size of the transform, which the inverse transform
+     * does not divide by, and by 2, for the way the spectra of a pair of
+     * channels are taken apart in run(). */
+    float scale = 0.5f / size;
+
+    for (int c = 0; c < channels; c ++)
+    {
+        int ir_c = (ir_channels == 1) ? 0 : c % ir_channels;
+
+        for (int p = 0; p < m_parts; p ++)
+        {
+            int first = p * block;
+            int count = aud::min (block, length - first);
+
+            for (int i = 0; i < size; i ++)
+            {
+                float tap = (i < count) ? ir[(offset + first + i) * ir_channels + ir_c] : 0;
+                m_buf[i] = FFT::Complex (tap * scale, 0);
+            }
+
+            m_fft.forward (m_buf.begin ());
+            memcpy (spectrum (m_filter, c, p), m_buf.begin (), sizeof (FFT::Complex) * bins);
+        }
+    }
+}
+
+void PartitionedConvolver::clear ()
+{
+    m_delay_line.erase (0, -1);
+    m_input.erase (0, -1);
+    m_output.erase (0, -1);
+    m_pos = 0;
+}
+
+void PartitionedConvolver::run ()
+{
+    int block = m_block;
+    int size = 2 * block;
+    int bins = block + 1;
+
+    FFT::Complex * buf = m_buf.begin ();
+    FFT::Complex * acc[2] = {m_acc.begin (), & m_acc[bins]};
+
+    for (int c = 0; c < m_channels; c += 2)
+    {
+        bool pair = (c + 1 < m_channels);
+        const float * x0 = & m_input[2 * c * block];
+        const float * x1 = pair ? x0 + size : nullptr;
+
+        for (int i = 0; i < size; i ++)
+            buf[i] = FFT::Complex (x0[i], pair ? x1[i] : 0);
+
+        m_fft.forward (buf);
+
+        /* Both spectra are conjugate symmetric, so only the first half is
+         * kept.  Each is twice the actual spectrum, which the filter makes up
+         * for. */
+        FFT::Complex * y0 = spectrum (m_delay_line, c, m_pos);
+        FFT::Complex * y1 = pair ? spectrum (m_delay_line, c + 1, m_pos) : nullptr;
+
+        for (int k = 0; k < bins; k ++)
+        {
+            FFT::Complex a = buf[k];
+            FFT::Complex b = std::conj (buf[(size - k) & (size - 1)]);
+
+            y0[k] = a + b;
+            if (pair)
+                y1[k] = (a - b) * FFT::Complex (0, -1);
+        }
+
+        /* multiply by the filter in the frequency domain */
+        for (int j = 0; j < 2 && c + j < m_channels; j ++)
+        {
+            memset ((void *) acc[j], 0, sizeof (FFT::Complex) * bins);
+
+            for (int p = 0; p < m_parts; p ++)
+            {
+                int slot = (m_pos - p + m_parts) % m_parts;
+                simd_cmac ((float *) acc[j], (const float *) spectrum (m_delay_line, c + j, slot),
+                 (const float *) spectrum (m_filter, c + j, p), bins);
+            }
+        }
+
+        /* put the pair back together and transform back */
+        for (int k = 0; k < bins; k ++)
+        {
+            FFT::Complex a = acc[0][k];
+            FFT::Complex b = pair ? acc[1][k] : 0;
+
+            buf[k] = FFT::Complex (a.real () - b.imag (), a.imag () + b.real ());
+        }
+
+        for (int k = bins; k < size; k ++)
+        {
+            FFT::Complex a = std::conj (acc[0][size - k]);
+            FFT::Complex b = pair ? std::conj (acc[1][size - k]) : 0;
+
+            buf[k] = FFT::Complex (a.real () - b.imag (), a.imag () + b.real ());
+        }
+
+        m_fft.inverse (buf);
+
+        /* the second half is the part not wrapped around by the transform */
+        float * out0 = output (c);
+        float * out1 = pair ? output (c + 1) : nullptr;
+
+        for (int i = 0; i < block; i ++)
+        {
+            out0[i] = buf[block + i].real ();
+            if (pair)
+                out1[i] = buf[block + i].imag ();
+        }
+    }
+
+    /* keep the newest block of input for the next overlap */
+    for (int c = 0; c < m_channels; c ++)
+        memcpy (& m_input[2 * c * block], input (c), sizeof (float) * block);
+
+    m_pos = (m_pos + 1) % m_parts;
+}
+
+/* Virtual file access wrappers for libsndfile, as in the sndfile plugin */
+static sf_count_t sf_get_filelen (void * user_data)
+{
+    int64_t size = ((VFSFile *) user_data)->fsize ();
+    return (size < 0) ? SF_COUNT_MAX : size;
+}
+
+static sf_count_t sf_vseek (sf_count_t offset, int whence, void * user_data)
+{
+    if (((VFSFile *) user_data)->fseek (offset, to_vfs_seek_type (whence)) != 0)
+        return -1;
+
+    return ((VFSFile *) user_data)->ftell ();
+}
+
+static sf_count_t sf_vread (void * ptr, sf_count_t count, void * user_data)
+{
+    return ((VFSFile *) user_data)->fread (ptr, 1, count);
+}
+
+static sf_count_t sf_vwrite_dummy (const void * ptr, sf_count_t count, void * user_data)
+{
+    return 0;
+}
+
+static sf_count_t sf_tell (void * user_data)
+{
+    return ((VFSFile *) user_data)->ftell ();
+}
+
+static SF_VIRTUAL_IO sf_virtual_io = {
+    sf_get_filelen,
+    sf_vseek,
+    sf_vread,
+    sf_vwrite_dummy,
+    sf_tell
+};
+
+static CachedSetting<float> gain_setting (CFGSECT, "gain");
+
+/* the impulse response prepared for one format */
+struct Filters
+{
+    int channels, rate;
+    int ir_frames;
+    bool have_tail;
+    PartitionedConvolver head, tail;
+};
+
+/* The impulse response is loaded and the filters are prepared by the main
+ * thread, for the format last started, and picked up by the audio thread.
+ * Only when the format changes does the audio thread prepare them itself. */
+static pthread_mutex_t ir_mutex = PTHREAD_MUTEX_INITIALIZER;
+static SmartPtr<ImpulseResponse> loaded_ir;
+static SmartPtr<Filters> prepared;  /* swapped with the filters in use */
+static int started_chans, started_rate;
+static bool ir_changed;
+static QueuedFunc reload_timer;
+
+/* audio thread state */
+static int curchans, currate;
+static bool active;
+static SmartPtr<Filters> filters;
+static int tail_fill, tail_read;
+static Index<float *> head_in, tail_in;
+static Index<const float *> head_out;
+static Index<float> pending, output;
+static float gain;
+
+static SmartPtr<ImpulseResponse> read_ir (const char * file)
+{
+    StringBuf uri = strstr (file, "://") ? str_copy (file) : filename_to_uri (file);
+
+    VFSFile vfs (uri, "r");
+    if (! vfs)
+    {
+        AUDERR ("%s: %s\n", file, vfs.error ());
+        return SmartPtr<ImpulseResponse> ();
+    }
+
+    SF_INFO sfinfo {};
+    SNDFILE * sndfile = sf_open_virtual (& sf_virtual_io, SFM_READ, & sfinfo, & vfs);
+
+    if (! sndfile)
+    {
+        AUDERR ("Cannot read impulse response %s: %s\n", file, sf_strerror (nullptr));
+        return SmartPtr<ImpulseResponse> ();
+    }
+
+    int max_frames = MAX_IR_SECONDS * sfinfo.samplerate;
+    if (sfinfo.frames > max_frames)
+        AUDWARN ("Impulse response %s cut to %d seconds.\n", file, MAX_IR_SECONDS);
+
+    SmartPtr<ImpulseResponse> ir (new ImpulseResponse);
+    ir->channels = sfinfo.channels;
+    ir->rate = sfinfo.samplerate;
+
+    int frames = aud::min (sfinfo.frames, (sf_count_t) max_frames);
+    ir->data.insert (0, frames * sfinfo.channels);
+    frames = sf_readf_float (sndfile, ir->data.begin (), frames);
+
+    sf_close (sndfile);
+
+    /* leave out the silence that responses are often padded with */
+    int samples = frames * sfinfo.channels;
+    while (samples > 0 && fabsf (ir->data[samples - 1]) < IR_SILENCE)
+        samples --;
+
+    frames = (samples + sfinfo.channels - 1) / sfinfo.channels;
+    ir->data.resize (frames * sfinfo.channels);
+
+    if (! frames)
+    {
+        AUDERR ("Impulse response %s is empty.\n", file);
+        return SmartPtr<ImpulseResponse> ();
+    }
+
+    AUDINFO ("Loaded impulse response %s: %d channels, %d Hz, %d frames.\n",
+     file, ir->channels, ir->rate, frames);
+
+    return ir;
+}
+
+/* Copies the impulse response into <taps>, converted to <rate>.  The taps are
+ * scaled so that the gain stays the same at the new rate. */
+static int get_taps (const ImpulseResponse & ir, int rate, Index<float> & taps)
+{
+    int frames = ir.data.len () / ir.channels;
+    int channels = ir.channels;
+
+    if (ir.rate == rate)
+        taps.insert (ir.data.begin (), 0, ir.data.len ());
+    else
+    {
+        double ratio = (double) rate / ir.rate;
+        int max_frames = (int) ceil (frames * ratio) + 1;
+
+        taps.insert (0, max_frames * channels);
+
+        SRC_DATA d = SRC_DATA ();
+
+        d.data_in = ir.data.begin ();
+        d.input_frames = frames;
+        d.data_out = taps.begin ();
+        d.output_frames = max_frames;
+        d.src_ratio = ratio;
+
+        int error = src_simple (& d, SRC_SINC_MEDIUM_QUALITY, channels);
+        if (error)
+        {
+            AUDERR ("%s\n", src_strerror (error));
+            return 0;
+        }
+
+        taps.resize (d.output_frames_gen * channels);
+        simd_ramp (taps.begin (), taps.len (), 1 / ratio, 0);
+    }
+
+    return taps.len () ? channels : 0;
+}
+
+/* Resamples the impulse response and transforms its partitions, which takes
+ * a while for a long response. */
+static SmartPtr<Filters> prepare_filters (const ImpulseResponse * ir, int channels, int rate)
+{
+    Index<float> taps;
+    int ir_channels = ir ? get_taps (* ir, rate, taps) : 0;
+
+    if (! ir_channels)
+        return SmartPtr<Filters> ();
+
+    if (ir_channels > 1 && ir_channels != channels)
+        AUDWARN ("Impulse response has %d channels, but the audio has %d.\n",
+         ir_channels, channels);
+
+    SmartPtr<Filters> f (new Filters);
+
+    f->channels = channels;
+    f->rate = rate;
+    f->ir_frames = taps.len () / ir_channels;
+    f->have_tail = (f->ir_frames > TAIL_BLOCK);
+
+    f->head.init (channels, HEAD_BLOCK, taps, ir_channels, 0,
+     aud::min (f->ir_frames, TAIL_BLOCK));
+    if (f->have_tail)
+        f->tail.init (channels, TAIL_BLOCK, taps, ir_channels, TAIL_BLOCK,
+         f->ir_frames - TAIL_BLOCK);
+
+    return f;
+}
+
+static void load_ir (void * = nullptr)
+{
+    String file = aud_get_str (CFGSECT, "file");
+    SmartPtr<ImpulseResponse> ir;
+
+    if (file[0])
+        ir = read_ir (file);
+
+    pthread_mutex_lock (& ir_mutex);
+    int channels = started_chans, rate = started_rate;
+    pthread_mutex_unlock (& ir_mutex);
+
+    SmartPtr<Filters> f;
+    if (channels)
+        f = prepare_filters (ir.get (), channels, rate);
+
+    pthread_mutex_lock (& ir_mutex);
+
+    /* if the format changed meanwhile, start() prepares them again anyway */
+    std::swap (loaded_ir, ir);
+    std::swap (prepared, f);
+    __atomic_store_n (& ir_changed, true, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock (& ir_mutex);
+}
+
+/* wait until the file name has been typed in full */
+static void file_changed ()
+{
+    reload_timer.queue (500, load_ir, nullptr);
+}
+
+static void update_gain ()
+{
+    gain_setting.update ();
+}
+
+/* Puts the filters in <prepared> in use.  The old ones are left in their place
+ * to be freed by the main thread.  Only if the format changed while they were
+ * being prepared are they prepared again here. */
+static void swap_filters ()
+{
+    pthread_mutex_lock (& ir_mutex);
+
+    if (! prepared || (prepared->channels == curchans && prepared->rate == currate))
+        std::swap (filters, prepared);
+    else
+        filters = prepare_filters (loaded_ir.get (), curchans, currate);
+
+    pthread_mutex_unlock (& ir_mutex);
+}
+
+static void setup ()
+{
+    active = false;
+
+    if (! filters)
+        return;
+
+    tail_fill = tail_read = 0;
+
+    head_in.resize (curchans);
+    tail_in.resize (curchans);
+    head_out.resize (curchans);
+
+    for (int c = 0; c < curchans; c ++)
+    {
+        head_in[c] = filters->head.input (c);
+        tail_in[c] = filters->have_tail ? filters->tail.input (c) : nullptr;
+        head_out[c] = filters->head.output (c);
+    }
+
+    active = true;
+}
+
+/* Convolves one block of HEAD_BLOCK frames. */
+static void run_block (const float * data, float * out)
+{
+    simd_deinterleave (data, head_in.begin (), curchans, HEAD_BLOCK);
+
+    PartitionedConvolver & head = filters->head;
+    PartitionedConvolver & tail = filters->tail;
+
+    if (filters->have_tail)
+    {
+        for (int c = 0; c < curchans; c ++)
+            memcpy (tail_in[c] + tail_fill, head_in[c], sizeof (float) * HEAD_BLOCK);
+    }
+
+    head.run ();
+
+    if (filters->have_tail)
+    {
+        for (int c = 0; c < curchans; c ++)
+            simd_mix (head.output (c), tail.output (c) + tail_read, HEAD_BLOCK);
+
+        tail_read += HEAD_BLOCK;
+        tail_fill += HEAD_BLOCK;
+
+        /* the output is used from the next block of the tail's size on */
+        if (tail_fill == TAIL_BLOCK)
+        {
+            tail.run ();
+            tail_fill = tail_read = 0;
+        }
+    }
+
+    simd_interleave (out, head_out.begin (), curchans, HEAD_BLOCK);
+
+    if (gain != 1)
+        simd_ramp (out, HEAD_BLOCK * curchans, gain, 0);
+}
+
+const char * const Convolver::defaults[] = {
+ "file", "",
+ "gain", "0",
+ nullptr};
+
+bool Convolver::init ()
+{
+    aud_config_set_defaults (CFGSECT, defaults);
+
+    gain_setting.update ();
+    load_ir ();
+
+    return true;
+}
+
+void Convolver::cleanup ()
+{
+    reload_timer.stop ();
+
+    pthread_mutex_lock (& ir_mutex);
+    loaded_ir.clear ();
+    prepared.clear ();
+    started_chans = started_rate = 0;
+    pthread_mutex_unlock (& ir_mutex);
+
+    active = false;
+    filters.clear ();
+    pending.clear ();
+    output.clear ();
+
+    curchans = currate = 0;
+}
+
+/* Between songs of the same format, the state is kept, so that the response
+ * of the last song rings on into the next one without a gap. */
+void Convolver::start (int & channels, int & rate)
+{
+    bool format_changed = (channels != curchans || rate != currate);
+
+    curchans = channels;
+    currate = rate;
+
+    if (format_changed)
+    {
+        /* the filters have to be prepared again, here */
+        pthread_mutex_lock (& ir_mutex);
+
+        started_chans = channels;
+        started_rate = rate;
+
+        __atomic_store_n (& ir_changed, false, __ATOMIC_RELAXED);
+        filters = prepare_filters (loaded_ir.get (), channels, rate);
+        prepared.clear ();
+
+        pthread_mutex_unlock (& ir_mutex);
+        setup ();
+    }
+    else if (__atomic_exchange_n (& ir_changed, false, __ATOMIC_ACQUIRE))
+    {
+        swap_filters ();
+        setup ();
+    }
+
+    /* leave room for a second of output, so that it does not have to grow
+     * during playback */
+    int size = curchans * currate;
+    if (output.len () < size)
+    {
+        output.insert (0, size);
+        output.resize (0);
+    }
+
+    if (format_changed)
+    {
+        pending.insert (0, HEAD_BLOCK * curchans);
+        pending.resize (0);
+    }
+}
+
+Index<float> & Convolver::process (Index<float> & data)
+{
+    if (__atomic_exchange_n (& ir_changed, false, __ATOMIC_ACQUIRE))
+    {
+        swap_filters ();
+        setup ();
+    }
+
+    if (! active)
+        return data;
+
+    gain = powf (10, gain_setting.get () / 20);
+
+    int block = HEAD_BLOCK * curchans;
+    const float * in = data.begin ();
+    int samples = data.len ();
+
+    output.resize (0);
+
+    while (samples > 0)
+    {
+        /* whole blocks are taken straight from the input */
+        if (! pending.len () && samples >= block)
+        {
+            run_block (in, output.insert (-1, block));
+            in += block;
+            samples -= block;
+            continue;
+        }
+
+        int count = aud::min (block - pending.len (), samples);
+        pending.insert (in, -1, count);
+        in += count;
+        samples -= count;
+
+        if (pending.len () == block)
+        {
+            run_block (pending.begin (), output.insert (-1, block));
+            pending.resize (0);
+        }
+    }
+
+    return output;
+}
+
+bool Convolver::flush (bool force)
+{
+    pending.resize (0);
+
+    if (active)
+    {
+        filters->head.clear ();
+        if (filters->have_tail)
+            filters->tail.clear ();
+
+        tail_fill = tail_read = 0;
+    }
+
+    return true;
+}
+
+/* At the end of the playlist, the input still held back is output, and the
+ * response is left to ring out. */
+Index<float> & Convolver::finish (Index<float> & data, bool end_of_playlist)
+{
+    Index<float> & out = process (data);
+
+    if (! active || ! end_of_playlist)
+        return out;
+
+    int block = HEAD_BLOCK * curchans;
+    int samples = pending.len () + (filters->ir_frames - 1) * curchans;
+
+    while (samples > 0)
+    {
+        pending.insert (-1, block - pending.len ());
+        run_block (pending.begin (), output.insert (-1, block));
+        pending.resize (0);
+
+        if (samples < block)
+            output.remove (output.len () - (block - samples), -1);
+
+        samples -= block;
+    }
+
+    flush (true);
+    return output;
+}
+
+int Convolver::adjust_delay (int delay)
+{
+    if (! active)
+        return delay;
+
+    return delay + aud::rescale (pending.len () / curchans, currate, 1000);
+}
+
+const PreferencesWidget Convolver::widgets[] = {
+    WidgetLabel (N_("<b>Impulse Response</b>")),
+    WidgetFileEntry (N_("File:"),
+        WidgetString (CFGSECT, "file", file_changed),
+        {FileSelectMode::File}),
+    WidgetLabel (N_("A response with one channel is used for all channels;\n"
+     "otherwise each channel has its own.")),
+    WidgetSpin (N_("Gain:"),
+        WidgetFloat (CFGSECT, "gain", update_gain),
+        {-24, 24, 0.5, N_("dB")})
+};
+
+const PluginPreferences Convolver::prefs = {{widgets}};
@@ -0,0 +1 @@
+#include "../dsp-common/fft.cc"
@@ -17,11 +17,23 @@
  * the use of this software.
  */
 
+#include <math.h>
+#include <stdint.h>
+
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
+#include <libaudcore/ringbuf.h>
 #include <libaudcore/runtime.h>
 
+#include "../dsp-common/cached-setting.h"
+#include "../dsp-common/simd.h"
+
+/* The fade curves are stored as tables of FADE_STEPS + 1 points.  Between two
+ * points, the gain is interpolated linearly, which lets each step of the curve
+ * be applied as a single vectorized ramp. */
+#define FADE_STEPS 1024
+
 enum
 {
     STATE_OFF,
@@ -31,11 +43,19 @@ enum
     STATE_FLUSHED
 };
 
+enum
+{
+    FADE_LINEAR,
+    FADE_EQUAL_POWER,
+    FADE_S_CURVE
+};
+
 static const char * const crossfade_defaults[] = {
     "automatic", "TRUE",
     "length", "5",
     "manual", "TRUE",
     "manual_length", "0.2",
+    "fade_shape", "0",
     nullptr
 };
 
@@ -43,18 +63,40 @@ static const char crossfade_about[] =
  N_("Crossfade Plugin for Audacious\n"
     "Copyright 2010-2014 John Lindgren");
 
+static CachedSetting<bool> automatic ("crossfade", "automatic");
+static CachedSetting<double> automatic_length ("crossfade", "length");
+static CachedSetting<bool> manual ("crossfade", "manual");
+static CachedSetting<double> manual_length ("crossfade", "manual_length");
+
+static void update_settings ()
+{
+    automatic.update ();
+    automatic_length.update ();
+    manual.update ();
+    manual_length.update ();
+}
+
+static const ComboItem fade_shape_list[] = {
+    ComboItem (N_("Linear"), FADE_LINEAR),
+    ComboItem (N_("Equal power"), FADE_EQUAL_POWER),
+    ComboItem (N_("S-curve"), FADE_S_CURVE)
+};
+
 static const PreferencesWidget crossfade_widgets[] = {
     WidgetLabel (N_("<b>Crossfade</b>")),
+    WidgetCombo (N_("Fade shape:"),
+        WidgetInt ("crossfade", "fade_shape"),
+        {{fade_shape_list}}),
     WidgetCheck (N_("On automatic song change"),
-        WidgetBool ("crossfade", "automatic")),
+        WidgetBool ("crossfade", "automatic", update_settings)),
     WidgetSpin (N_("Overlap:"),
-        WidgetFloat ("crossfade", "length"),
+        WidgetFloat ("crossfade", "length", update_settings),
         {1, 15, 0.5, N_("seconds")},
         WIDGET_CHILD),
     WidgetCheck (N_("On seek or manual song change"),
-        WidgetBool ("crossfade", "manual")),
+        WidgetBool ("crossfade", "manual", update_settings)),
     WidgetSpin (N_("Overlap:"),
-        WidgetFloat ("crossfade", "manual_length"),
+        WidgetFloat ("crossfade", "manual_length", update_settings),
         {0.1, 3.0, 0.1, N_("seconds")},
         WIDGET_CHILD),
     WidgetLabel (N_("<b>Tip</b>")),
@@ -91,35 +133,116 @@ EXPORT Crossfade aud_plugin_instance;
 
 static char state = STATE_OFF;
 static int current_channels, current_rate;
-static Index<float> buffer, output;
+static RingBuf<float> buffer;
+static Index<float> output;
 static int fadein_point;
+static float fadein_curve[FADE_STEPS + 1], fadeout_curve[FADE_STEPS + 1];
 
 bool Crossfade::init ()
 {
     aud_config_set_defaults ("crossfade", crossfade_defaults);
+    update_settings ();
     return true;
 }
 
 void Crossfade::cleanup ()
 {
     state = STATE_OFF;
-    buffer.clear ();
+    buffer.destroy ();
     output.clear ();
 }
 
-static void do_ramp (float * data, int length, float a, float b)
+static void build_curves ()
+{
+    int shape = aud_get_int ("crossfade", "fade_shape");
+
+    for (int i = 0; i <= FADE_STEPS; i ++)
+    {
+        double x = (double) i / FADE_STEPS;
+
+        switch (shape)
+        {
+        case FADE_EQUAL_POWER:
+            fadein_curve[i] = sin (x * M_PI / 2);
+            fadeout_curve[i] = cos (x * M_PI / 2);
+            break;
+        case FADE_S_CURVE:
+            fadein_curve[i] = (1 - cos (x * M_PI)) / 2;
+            fadeout_curve[i] = (1 + cos (x * M_PI)) / 2;
+            break;
+        default:
+            fadein_curve[i] = x;
+            fadeout_curve[i] = 1 - x;
+            break;
+        }
+    }
+}
+
+/* Applies samples [pos, pos + length) of a fade lasting <total> samples.  If
+ * <mix_into> is given, the faded samples are added to it and <data> is left
+ * untouched; otherwise, <data> is faded in place. */
+static void do_fade (const float * curve, float * data, float * mix_into,
+ int length, int pos, int total)
+{
+    int end = pos + length;
+
+    while (pos < end)
+    {
+        int step = (int64_t) pos * FADE_STEPS / total;
+        int step_end = ((int64_t) (step + 1) * total + FADE_STEPS - 1) / FADE_STEPS;
+        int count = aud::min (step_end, end) - pos;
+
+        float slope = (curve[step + 1] - curve[step]) * FADE_STEPS / total;
+        float gain = curve[step] + slope * (pos - (float) step * total / FADE_STEPS);
+
+        if (mix_into)
+        {
+            simd_mix_ramp (mix_into, data, count, gain, slope);
+            mix_into += count;
+        }
+        else
+            simd_ramp (data, count, gain, slope);
+
+        data += count;
+        pos += count;
+    }
+}
+
+/* Runs do_fade() over samples [pos, pos + length) of the buffer, as part of a
+ * fade lasting the whole buffer.  The buffer may wrap around the end of its
+ * storage, so this is done in up to two contiguous pieces.  If <data> is
+ * given, it is faded and added to the buffer; otherwise, the buffer is faded
+ * in place. */
+static void fade_buffer (const float * curve, float * data, int pos, int length)
 {
-    for (int i = 0; i < length; i ++)
+    int total = buffer.len ();
+    int linear = buffer.linear ();
+    int end = pos + length;
+
+    while (pos < end)
     {
-        * data = (* data) * (a * (length - i) + b * i) / length;
-        data ++;
+        int count = aud::min (end, (pos < linear) ? linear : total) - pos;
+
+        if (data)
+        {
+            do_fade (curve, data, & buffer[pos], count, pos, total);
+            data += count;
+        }
+        else
+            do_fade (curve, & buffer[pos], nullptr, count, pos, total);
+
+        pos += count;
     }
 }
 
-static void mix (float * data, float * add, int length)
+/* Appends to the buffer.  The buffer is allocated in start(), so it only needs
+ * to grow here if the decoder passes an unusually large chunk of audio. */
+static void buffer_in (const float * data, int len)
 {
-    while (length --)
-        (* data ++) += (* add ++);
+    if (buffer.space () < len)
+        buffer.alloc (buffer.len () + len + current_channels * current_rate);
+
+    buffer.copy_in (data, len);
 }
 
 /* stupid simple resampling/rechanneling algorithm */
@@ -148,18 +271,22 @@ static void reformat (int channels, int rate)
             new_buffer[s + c] = buffer[s0 + map[c]];
     }
 
-    buffer = std::move (new_buffer);
+    buffer.discard ();
+    if (buffer.size () < new_buffer.len ())
+        buffer.alloc (new_buffer.len ());
+
+    buffer.copy_in (new_buffer.begin (), new_buffer.len ());
 }
 
 static int buffer_needed_for_state ()
 {
     double overlap = 0;
 
-    if (state != STATE_FLUSHED && aud_get_bool ("crossfade", "automatic"))
-        overlap = aud_get_double ("crossfade", "length");
+    if (state != STATE_FLUSHED && automatic.get ())
+        overlap = automatic_length.get ();
 
-    if (state != STATE_FINISHED && aud_get_bool ("crossfade", "manual"))
-        overlap = aud::max (overlap, aud_get_double ("crossfade", "manual_length"));
+    if (state != STATE_FINISHED && manual.get ())
+        overlap = aud::max (overlap, manual_length.get ());
 
     return current_channels * (int) (current_rate * overlap);
 }
@@ -170,7 +297,7 @@ static void output_data_as_ready (int buffer_needed, bool exact)
 
     /* if allowed, wait until we have at least 1/2 second ready to output */
     if (exact ? (copy > 0) : (copy >= current_channels * (current_rate / 2)))
-        output.move_from (buffer, 0, -1, copy, true, true);
+        buffer.move_out (output, -1, copy);
 }
 
 void Crossfade::start (int & channels, int & rate)
@@ -181,12 +308,28 @@ void Crossfade::start (int & channels, int & rate)
     current_channels = channels;
     current_rate = rate;
 
+    build_curves ();
+
+    /* The buffer holds the longest overlap, up to half a second waiting to be
+     * output, and the newest input.  Allocate it (and the output buffer) here,
+     * so that process() neither allocates nor moves memory during playback. */
+    double overlap = aud::max (automatic_length.get (), manual_length.get ());
+    int size = current_channels * (int) (current_rate * (overlap + 1));
+
+    if (buffer.size () < size)
+        buffer.alloc (size);
+
+    output.insert (0, size);
+    output.resize (0);
+
     if (state == STATE_OFF)
     {
-        if (aud_get_bool ("crossfade", "manual"))
+        if (manual.get ())
         {
             state = STATE_FLUSHED;
-            buffer.insert (0, buffer_needed_for_state ());
+
+            for (int i = buffer_needed_for_state (); i > 0; i --)
+                buffer.push (0.0f);
         }
         else
             state = STATE_RUNNING;
@@ -195,31 +338,29 @@ void Crossfade::start (int & channels, int & rate)
 
 static void run_fadeout ()
 {
-    do_ramp (buffer.begin (), buffer.len (), 1.0, 0.0);
+    fade_buffer (fadeout_curve, nullptr, 0, buffer.len ());
 
     state = STATE_FADEIN;
     fadein_point = 0;
 }
 
-static void run_fadein (Index<float> & data)
+/* returns the number of samples mixed into the buffer */
+static int run_fadein (Index<float> & data)
 {
     int length = buffer.len ();
+    int copy = 0;
 
     if (fadein_point < length)
     {
-        int copy = aud::min (data.len (), length - fadein_point);
-        float a = (float) fadein_point / length;
-        float b = (float) (fadein_point + copy) / length;
-
-        do_ramp (data.begin (), copy, a, b);
-        mix (& buffer[fadein_point], data.begin (), copy);
-        data.remove (0, copy);
-
+        copy = aud::min (data.len (), length - fadein_point);
+        fade_buffer (fadein_curve, data.begin (), fadein_point, copy);
         fadein_point += copy;
     }
 
     if (fadein_point == length)
         state = STATE_RUNNING;
+
+    return copy;
 }
 
 Index<float> & Crossfade::process (Index<float> & data)
@@ -229,15 +370,17 @@ Index<float> & Crossfade::process (Index<float> & data)
 
     output.resize (0);
 
+    int used = 0;
+
     if (state == STATE_FINISHED || state == STATE_FLUSHED)
         run_fadeout ();
 
     if (state == STATE_FADEIN)
-        run_fadein (data);
+        used = run_fadein (data);
 
     if (state == STATE_RUNNING)
     {
-        buffer.insert (data.begin (), -1, data.len ());
+        buffer_in (data.begin () + used, data.len () - used);
         output_data_as_ready (buffer_needed_for_state (), false);
     }
 
@@ -249,18 +392,26 @@ bool Crossfade::flush (bool force)
     if (state == STATE_OFF)
         return true;
 
-    if (! force && aud_get_bool ("crossfade", "manual"))
+    if (! force && manual.get ())
     {
         state = STATE_FLUSHED;
         int buffer_needed = buffer_needed_for_state ();
+
+        /* keep the oldest samples, using the output buffer as scratch space */
         if (buffer.len () > buffer_needed)
-            buffer.remove (buffer_needed, -1);
+        {
+            output.resize (0);
+            buffer.move_out (output, -1, buffer_needed);
+            buffer.discard ();
+            buffer.copy_in (output.begin (), buffer_needed);
+            output.resize (0);
+        }
 
         return false;
     }
 
     state = STATE_RUNNING;
-    buffer.resize (0);
+    buffer.discard ();
 
     return true;
 }
@@ -272,18 +423,20 @@ Index<float> & Crossfade::finish (Index<float> & data, bool end_of_playlist)
 
     output.resize (0);
 
+    int used = 0;
+
     if (state == STATE_FADEIN)
-        run_fadein (data);
+        used = run_fadein (data);
 
     if (state == STATE_RUNNING || state == STATE_FINISHED || state == STATE_FLUSHED)
     {
-        buffer.insert (data.begin (), -1, data.len ());
+        buffer_in (data.begin () + used, data.len () - used);
         output_data_as_ready (buffer_needed_for_state (), state != STATE_RUNNING);
     }
 
     if (state == STATE_FADEIN || state == STATE_RUNNING)
     {
-        if (aud_get_bool ("crossfade", "automatic"))
+        if (automatic.get ())
         {
             state = STATE_FINISHED;
             output_data_as_ready (buffer_needed_for_state (), true);
@@ -297,7 +450,7 @@ Index<float> & Crossfade::finish (Index<float> & data, bool end_of_playlist)
 
     if (end_of_playlist && (state == STATE_FINISHED || state == STATE_FLUSHED))
     {
-        do_ramp (buffer.begin (), buffer.len (), 1.0, 0.0);
+        fade_buffer (fadeout_curve, nullptr, 0, buffer.len ());
 
         state = STATE_OFF;
         output_data_as_ready (0, true);
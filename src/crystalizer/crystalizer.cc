@@ -18,6 +18,7 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <libaudcore/hook.h>
 #include <libaudcore/i18n.h>
 #include <libaudcore/runtime.h>
 #include <libaudcore/plugin.h>
@@ -27,10 +28,16 @@ static const char * const cryst_defaults[] = {
  "intensity", "1",
  nullptr};
 
+/* the intensity is shared with the Stereo Effects plugin */
+static void intensity_changed ()
+{
+    hook_call ("crystalizer settings changed", nullptr);
+}
+
 static const PreferencesWidget cryst_widgets[] = {
     WidgetLabel (N_("<b>Crystalizer</b>")),
     WidgetSpin (N_("Intensity:"),
-        WidgetFloat ("crystalizer", "intensity"),
+        WidgetFloat ("crystalizer", "intensity", intensity_changed),
         {0, 10, 0.1})
 };
 
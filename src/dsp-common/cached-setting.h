@@ -0,0 +1,82 @@
+/*
+ * cached-setting.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef DSP_COMMON_CACHED_SETTING_H
+#define DSP_COMMON_CACHED_SETTING_H
+
+#include <libaudcore/runtime.h>
+
+// Settings cached for the audio thread.  aud_get_*() looks the setting up by
+// name under a lock, which is too slow to do for every buffer.  Instead, the
+// main thread refreshes the cache from init() and from the callbacks of the
+// preferences widgets, and the audio thread reads it without locking.  Each
+// value is replaced atomically, but a group of values is not, so a buffer may
+// see a mix of old and new settings.
+
+// a value written by one thread and read by another
+template<class T>
+class AtomicValue
+{
+public:
+    constexpr AtomicValue (T value = T ()) :
+        m_value (value) {}
+
+    T get () const
+    {
+        T value;
+        __atomic_load (& m_value, & value, __ATOMIC_RELAXED);
+        return value;
+    }
+
+    void set (T value)
+        { __atomic_store (& m_value, & value, __ATOMIC_RELAXED); }
+
+private:
+    T m_value;
+};
+
+// a value read from the config database by update()
+template<class T>
+class CachedSetting : public AtomicValue<T>
+{
+public:
+    constexpr CachedSetting (const char * section, const char * name) :
+        m_section (section),
+        m_name (name) {}
+
+    void update ();
+
+private:
+    const char * m_section, * m_name;
+};
+
+template<>
+inline void CachedSetting<bool>::update ()
+    { set (aud_get_bool (m_section, m_name)); }
+template<>
+inline void CachedSetting<int>::update ()
+    { set (aud_get_int (m_section, m_name)); }
+template<>
+inline void CachedSetting<float>::update ()
+    { set (aud_get_double (m_section, m_name)); }
+template<>
+inline void CachedSetting<double>::update ()
+    { set (aud_get_double (m_section, m_name)); }
+
+#endif // DSP_COMMON_CACHED_SETTING_H
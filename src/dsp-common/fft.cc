@@ -0,0 +1,101 @@
+/*
+ * fft.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "fft.h"
+
+#include <math.h>
+#include <utility>
+
+int FFT::size_for (int n)
+{
+    int size = 1;
+    while (size < n)
+        size <<= 1;
+
+    return size;
+}
+
+void FFT::init (int size)
+{
+    if (size == m_size)
+        return;
+
+    m_size = size;
+
+    int bits = 0;
+    while ((1 << bits) < size)
+        bits ++;
+
+    m_reverse.resize (size);
+    for (int i = 0; i < size; i ++)
+    {
+        int r = 0;
+        for (int b = 0; b < bits; b ++)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+
+        m_reverse[i] = r;
+    }
+
+    /* computed in double precision to keep large transforms accurate */
+    m_twiddle.resize (size / 2);
+    m_twiddle_inv.resize (size / 2);
+
+    for (int i = 0; i < size / 2; i ++)
+    {
+        double angle = -2.0 * M_PI * i / size;
+        m_twiddle[i] = Complex (cos (angle), sin (angle));
+        m_twiddle_inv[i] = std::conj (m_twiddle[i]);
+    }
+}
+
+void FFT::clear ()
+{
+    m_size = 0;
+    m_twiddle.clear ();
+    m_twiddle_inv.clear ();
+    m_reverse.clear ();
+}
+
+void FFT::transform (Complex * data, const Complex * twiddle) const
+{
+    for (int i = 0; i < m_size; i ++)
+    {
+        int r = m_reverse[i];
+        if (r > i)
+            std::swap (data[i], data[r]);
+    }
+
+    for (int half = 1; half < m_size; half <<= 1)
+    {
+        int stride = m_size / (half * 2);
+
+        for (int start = 0; start < m_size; start += half * 2)
+        {
+            Complex * a = data + start;
+            Complex * b = a + half;
+
+            for (int k = 0; k < half; k ++)
+            {
+                Complex t = b[k] * twiddle[k * stride];
+                b[k] = a[k] - t;
+                a[k] += t;
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * fft.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef DSP_COMMON_FFT_H
+#define DSP_COMMON_FFT_H
+
+#include <complex>
+#include <libaudcore/index.h>
+
+// In-place radix-2 complex FFT.  The twiddle factors and the bit-reversal
+// permutation are computed once by init(), so transforms never allocate.  The
+// inverse transform is not scaled; divide by size() to round-trip.
+
+class FFT
+{
+public:
+    typedef std::complex<float> Complex;
+
+    // size must be a power of two
+    void init (int size);
+    void clear ();
+
+    int size () const
+        { return m_size; }
+
+    void forward (Complex * data) const
+        { transform (data, m_twiddle.begin ()); }
+    void inverse (Complex * data) const
+        { transform (data, m_twiddle_inv.begin ()); }
+
+    // smallest power of two not less than n
+    static int size_for (int n);
+
+private:
+    void transform (Complex * data, const Complex * twiddle) const;
+
+    int m_size = 0;
+    Index<Complex> m_twiddle, m_twiddle_inv;
+    Index<int> m_reverse;
+};
+
+#endif // DSP_COMMON_FFT_H
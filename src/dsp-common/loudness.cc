@@ -0,0 +1,250 @@
+/*
+ * loudness.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "loudness.h"
+#include "simd.h"
+#include "true-peak.h"
+
+#include <math.h>
+
+#define STEPS_PER_BLOCK 4        // 400 ms gating blocks,
+#define STEPS_PER_SHORT_TERM 30  // 3 s short-term blocks,
+#define SHORT_TERM_HOP 10        // taken every second
+
+#define ABSOLUTE_GATE -70.0  // LUFS
+#define RELATIVE_GATE -10.0  // LU, for the integrated loudness
+#define RANGE_GATE -20.0     // LU, for the loudness range
+
+static double power_to_lufs (double power)
+    { return -0.691 + 10 * log10 (power); }
+static double lufs_to_power (double lufs)
+    { return pow (10, (lufs + 0.691) / 10); }
+
+// BS.1770 gives the K-weighting filter for 48 kHz only.  These are the analog
+// prototypes of its two stages (a high shelf and a high-pass), so that other
+// rates get the same response.
+static void kweight_coefs (int rate, double * coefs)
+{
+    double f0 = 1681.974450955533;
+    double gain = 3.999843853973347;
+    double q = 0.7071752369554196;
+
+    double k = tan (M_PI * f0 / rate);
+    double vh = pow (10, gain / 20);
+    double vb = pow (vh, 0.4996667741545416);
+    double a0 = 1 + k / q + k * k;
+
+    coefs[0] = (vh + vb * k / q + k * k) / a0;
+    coefs[1] = 2 * (k * k - vh) / a0;
+    coefs[2] = (vh - vb * k / q + k * k) / a0;
+    coefs[3] = 2 * (k * k - 1) / a0;
+    coefs[4] = (1 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+
+    k = tan (M_PI * f0 / rate);
+    a0 = 1 + k / q + k * k;
+
+    coefs[5] = 1;
+    coefs[6] = -2;
+    coefs[7] = 1;
+    coefs[8] = 2 * (k * k - 1) / a0;
+    coefs[9] = (1 - k / q + k * k) / a0;
+}
+
+// BS.1770 leaves out the LFE channel and weights the surround channels by
+// +1.5 dB.  The layouts are those used by the channel mixer: L R C Ls Rs for 5
+// channels, L R C LFE followed by the surround channels for 6 and 8.
+static double channel_weight (int channels, int c)
+{
+    if (channels == 5)
+        return (c >= 3) ? 1.41 : 1;
+    if (channels == 6 || channels == 8)
+        return (c == 3) ? 0 : (c > 3) ? 1.41 : 1;
+
+    return 1;
+}
+
+void LoudnessMeter::start (int channels, int rate)
+{
+    m_channels = channels;
+    m_step_frames = (rate + 5) / 10;
+    m_frames = 0;
+
+    kweight_coefs (rate, m_coefs);
+
+    m_state.resize (0);
+    m_state.insert (0, 4 * channels);
+    m_power.resize (0);
+    m_power.insert (0, channels);
+    m_hist.resize (0);
+    m_hist.insert (0, (TRUE_PEAK_TAPS - 1) * channels);
+    m_peaks.resize (0);
+    m_peaks.insert (0, channels);
+
+    m_weights.resize (channels);
+    for (int c = 0; c < channels; c ++)
+        m_weights[c] = channel_weight (channels, c);
+
+    m_step_count = 0;
+    m_blocks.resize (0);
+    m_short_term.resize (0);
+}
+
+void LoudnessMeter::process (const float * data, int frames)
+{
+    simd_peak4 (data, m_channels, frames, true_peak_filter, TRUE_PEAK_TAPS,
+     m_hist.begin (), m_peaks.begin ());
+
+    while (frames > 0)
+    {
+        int len = aud::min (frames, m_step_frames - m_frames);
+
+        simd_biquad2_power (data, m_channels, len, m_coefs, m_state.begin (),
+         m_power.begin ());
+
+        data += len * m_channels;
+        frames -= len;
+        m_frames += len;
+
+        if (m_frames == m_step_frames)
+            end_step ();
+    }
+}
+
+void LoudnessMeter::end_step ()
+{
+    double power = 0;
+
+    for (int c = 0; c < m_channels; c ++)
+    {
+        power += m_weights[c] * m_power[c];
+        m_power[c] = 0;
+    }
+
+    m_steps[m_step_count % STEPS_PER_SHORT_TERM] = power / m_step_frames;
+    m_step_count ++;
+    m_frames = 0;
+
+    // The filters decay slowly towards zero in silence; stop them well before
+    // they reach the range of denormal numbers, which are slow to compute with.
+    for (double & s : m_state)
+    {
+        if (fabs (s) < 1e-15)
+            s = 0;
+    }
+
+    if (m_step_count >= STEPS_PER_BLOCK)
+        m_blocks.append (mean_power (STEPS_PER_BLOCK));
+
+    if (m_step_count >= STEPS_PER_SHORT_TERM &&
+     (m_step_count - STEPS_PER_SHORT_TERM) % SHORT_TERM_HOP == 0)
+        m_short_term.append (mean_power (STEPS_PER_SHORT_TERM));
+}
+
+double LoudnessMeter::mean_power (int steps) const
+{
+    double sum = 0;
+    for (int i = m_step_count - steps; i < m_step_count; i ++)
+        sum += m_steps[i % STEPS_PER_SHORT_TERM];
+
+    return sum / steps;
+}
+
+double LoudnessMeter::gated_loudness (const Index<double> & blocks)
+{
+    double gate = lufs_to_power (ABSOLUTE_GATE);
+    double sum = 0;
+    int count = 0;
+
+    for (double power : blocks)
+    {
+        if (power > gate)
+        {
+            sum += power;
+            count ++;
+        }
+    }
+
+    if (! count)
+        return -HUGE_VAL;
+
+    gate = aud::max (gate, sum / count * pow (10, RELATIVE_GATE / 10));
+    sum = 0;
+    count = 0;
+
+    for (double power : blocks)
+    {
+        if (power > gate)
+        {
+            sum += power;
+            count ++;
+        }
+    }
+
+    return power_to_lufs (sum / count);
+}
+
+double LoudnessMeter::range () const
+{
+    double gate = lufs_to_power (ABSOLUTE_GATE);
+    double sum = 0;
+    Index<double> gated;
+
+    for (double power : m_short_term)
+    {
+        if (power > gate)
+        {
+            gated.append (power);
+            sum += power;
+        }
+    }
+
+    if (! gated.len ())
+        return 0;
+
+    gate = sum / gated.len () * pow (10, RANGE_GATE / 10);
+
+    int count = 0;
+    for (double power : gated)
+    {
+        if (power > gate)
+            gated[count ++] = power;
+    }
+
+    gated.remove (count, -1);
+    gated.sort ([] (const double & a, const double & b)
+        { return (a < b) ? -1 : (a > b) ? 1 : 0; });
+
+    // the range between the 10th and the 95th percentile
+    double low = gated[(int) ((count - 1) * 0.10 + 0.5)];
+    double high = gated[(int) ((count - 1) * 0.95 + 0.5)];
+
+    return power_to_lufs (high) - power_to_lufs (low);
+}
+
+float LoudnessMeter::true_peak () const
+{
+    float peak = 0;
+    for (float p : m_peaks)
+        peak = aud::max (peak, p);
+
+    return peak;
+}
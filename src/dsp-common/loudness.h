@@ -0,0 +1,75 @@
+/*
+ * loudness.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef DSP_COMMON_LOUDNESS_H
+#define DSP_COMMON_LOUDNESS_H
+
+#include <libaudcore/index.h>
+
+// Loudness measurement as specified by ITU-R BS.1770-4 and EBU R 128: the
+// integrated (gated) loudness, the loudness range of EBU Tech 3342, and the
+// true peak, found by upsampling 4 times.  The audio is K-weighted and split
+// into steps of 100 ms; the mean square power of each 400 ms gating block and
+// of each 3 s short-term block is kept for the gated measurements at the end.
+// The blocks of several meters can be put together to measure the loudness of
+// a whole album.
+
+class LoudnessMeter
+{
+public:
+    void start (int channels, int rate);
+
+    // interleaved frames of the channel count given to start()
+    void process (const float * data, int frames);
+
+    // in LUFS, or -HUGE_VAL if there is nothing above the absolute gate
+    double integrated () const
+        { return gated_loudness (m_blocks); }
+
+    // in LU
+    double range () const;
+
+    // linear, relative to full scale
+    float true_peak () const;
+
+    // the power of each gating block
+    const Index<double> & blocks () const
+        { return m_blocks; }
+
+    // integrated loudness of any set of gating blocks
+    static double gated_loudness (const Index<double> & blocks);
+
+private:
+    void end_step ();
+    double mean_power (int steps) const;
+
+    int m_channels = 0;
+    int m_step_frames = 0, m_frames = 0;
+    double m_coefs[10];
+
+    Index<double> m_state, m_power, m_weights;
+    Index<float> m_hist, m_peaks;
+
+    double m_steps[30];  // the power of the last 30 steps, circular
+    int m_step_count = 0;
+
+    Index<double> m_blocks, m_short_term;
+};
+
+#endif // DSP_COMMON_LOUDNESS_H
@@ -0,0 +1,1340 @@
+/*
+ * simd.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "simd.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__ ((target ("sse2")))
+#define TARGET_AVX2 __attribute__ ((target ("avx2")))
+#endif
+
+// The gain of a ramp is computed from the sample index rather than by
+// repeated addition, so that long ramps do not accumulate rounding error.
+
+/* ----- portable versions ----- */
+
+static void ramp_c (float * data, int len, float start, float step)
+{
+    for (int i = 0; i < len; i ++)
+        data[i] *= start + step * i;
+}
+
+static void mix_c (float * data, const float * add, int len)
+{
+    for (int i = 0; i < len; i ++)
+        data[i] += add[i];
+}
+
+static void mix_ramp_c (float * data, const float * add, int len, float start, float step)
+{
+    for (int i = 0; i < len; i ++)
+        data[i] += add[i] * (start + step * i);
+}
+
+static void mix_mul_c (float * data, const float * add, const float * gain, int len)
+{
+    for (int i = 0; i < len; i ++)
+        data[i] += add[i] * gain[i];
+}
+
+static float dot_c (const float * a, const float * b, int len)
+{
+    float sum = 0;
+    for (int i = 0; i < len; i ++)
+        sum += a[i] * b[i];
+
+    return sum;
+}
+
+static int find_above_c (const float * data, int len, float threshold)
+{
+    for (int i = 0; i < len; i ++)
+    {
+        if (fabsf (data[i]) > threshold)
+            return i;
+    }
+
+    return -1;
+}
+
+static int rfind_above_c (const float * data, int len, float threshold)
+{
+    for (int i = len - 1; i >= 0; i --)
+    {
+        if (fabsf (data[i]) > threshold)
+            return i;
+    }
+
+    return -1;
+}
+
+static void delay_c (float * data, const float * delayed, float * store, int len,
+ float wet, float feedback)
+{
+    for (int i = 0; i < len; i ++)
+    {
+        float in = data[i], d = delayed[i];
+        data[i] = in + d * wet;
+        store[i] = in + d * feedback;
+    }
+}
+
+static void delay_cross_c (float * data, const float * delayed, float * store, int len,
+ float wet, float feedback)
+{
+    for (int i = 0; i + 1 < len; i += 2)
+    {
+        float in0 = data[i], in1 = data[i + 1];
+        float d0 = delayed[i], d1 = delayed[i + 1];
+        data[i] = in0 + d0 * wet;
+        data[i + 1] = in1 + d1 * wet;
+        store[i] = in0 + d1 * feedback;
+        store[i + 1] = in1 + d0 * feedback;
+    }
+}
+
+static void matrix_c (const float * in, float * out, int frames, int in_ch, int out_ch,
+ const float * matrix)
+{
+    for (int f = 0; f < frames; f ++)
+    {
+        for (int o = 0; o < out_ch; o ++)
+        {
+            const float * row = matrix + o * in_ch;
+            float sum = 0;
+
+            for (int i = 0; i < in_ch; i ++)
+                sum += in[i] * row[i];
+
+            out[o] = sum;
+        }
+
+        in += in_ch;
+        out += out_ch;
+    }
+}
+
+static SimdMatrixFunc matrix_func_c (int in_ch, int out_ch)
+{
+    return matrix_c;
+}
+
+static void stereo_fir_c (float * data, int frames, const float * a, const float * b,
+ float * prev)
+{
+    float prev_l = prev[0], prev_r = prev[1];
+
+    for (int n = 0; n < frames; n ++)
+    {
+        float l = data[2 * n], r = data[2 * n + 1];
+        data[2 * n] = a[0] * l + a[1] * r + b[0] * prev_l + b[1] * prev_r;
+        data[2 * n + 1] = a[2] * l + a[3] * r + b[2] * prev_l + b[3] * prev_r;
+        prev_l = l;
+        prev_r = r;
+    }
+
+    prev[0] = prev_l;
+    prev[1] = prev_r;
+}
+
+// the vectorized versions handle leading frames and leave the rest from
+// <start> on to these
+static void deinterleave_from (const float * data, float * const * bufs, int channels,
+ int start, int frames)
+{
+    for (int c = 0; c < channels; c ++)
+    {
+        const float * in = data + c;
+        float * out = bufs[c];
+
+        for (int f = start; f < frames; f ++)
+            out[f] = in[f * channels];
+    }
+}
+
+static void interleave_from (float * data, const float * const * bufs, int channels,
+ int start, int frames)
+{
+    for (int c = 0; c < channels; c ++)
+    {
+        const float * in = bufs[c];
+        float * out = data + c;
+
+        for (int f = start; f < frames; f ++)
+            out[f * channels] = in[f];
+    }
+}
+
+static void deinterleave_c (const float * data, float * const * bufs, int channels,
+ int frames)
+{
+    deinterleave_from (data, bufs, channels, 0, frames);
+}
+
+static void interleave_c (float * data, const float * const * bufs, int channels,
+ int frames)
+{
+    interleave_from (data, bufs, channels, 0, frames);
+}
+
+static void biquad2_power_from (const float * data, int channels, int start,
+ int frames, const double * coefs, double * state, double * power)
+{
+    const double * f = coefs, * g = coefs + 5;
+
+    for (int c = start; c < channels; c ++)
+    {
+        double s0 = state[c], s1 = state[channels + c];
+        double s2 = state[2 * channels + c], s3 = state[3 * channels + c];
+        double sum = 0;
+
+        for (int n = 0; n < frames; n ++)
+        {
+            double x = data[n * channels + c];
+            double y = f[0] * x + s0;
+            s0 = f[1] * x - f[3] * y + s1;
+            s1 = f[2] * x - f[4] * y;
+
+            double z = g[0] * y + s2;
+            s2 = g[1] * y - g[3] * z + s3;
+            s3 = g[2] * y - g[4] * z;
+
+            sum += z * z;
+        }
+
+        state[c] = s0;
+        state[channels + c] = s1;
+        state[2 * channels + c] = s2;
+        state[3 * channels + c] = s3;
+        power[c] += sum;
+    }
+}
+
+static void biquad2_power_c (const float * data, int channels, int frames,
+ const double * coefs, double * state, double * power)
+{
+    biquad2_power_from (data, channels, 0, frames, coefs, state, power);
+}
+
+// The peak kernels work on one channel at a time, copied into a linear buffer
+// after the history, so that the filter can read it without wrapping around.
+// Each returns the peak of <len> samples starting after <taps> - 1 samples of
+// history in <buf>.
+
+#define PEAK4_MAX_TAPS 16
+#define PEAK4_CHUNK 256
+
+typedef float (* Peak4Kernel) (const float * buf, int len, const float * coefs,
+ int taps);
+
+static float peak4_kernel_c (const float * buf, int len, const float * coefs,
+ int taps)
+{
+    float peak = 0;
+
+    for (int n = 0; n < len; n ++)
+    {
+        const float * x = buf + taps - 1 + n;
+
+        for (int p = 0; p < 4; p ++)
+        {
+            float sum = 0;
+            for (int k = 0; k < taps; k ++)
+                sum += coefs[k * 4 + p] * x[-k];
+
+            peak = fmaxf (peak, fabsf (sum));
+        }
+    }
+
+    return peak;
+}
+
+static void peak4_common (const float * data, int channels, int frames,
+ const float * coefs, int taps, float * hist, float * peak, Peak4Kernel kernel)
+{
+    float buf[PEAK4_MAX_TAPS - 1 + PEAK4_CHUNK];
+    int keep = taps - 1;
+
+    for (int c = 0; c < channels; c ++)
+    {
+        float * h = hist + c * keep;
+        memcpy (buf, h, sizeof (float) * keep);
+
+        for (int start = 0; start < frames; start += PEAK4_CHUNK)
+        {
+            int len = (frames - start < PEAK4_CHUNK) ? frames - start : PEAK4_CHUNK;
+            const float * in = data + start * channels + c;
+
+            for (int n = 0; n < len; n ++)
+                buf[keep + n] = in[n * channels];
+
+            peak[c] = fmaxf (peak[c], kernel (buf, len, coefs, taps));
+            memmove (buf, buf + len, sizeof (float) * keep);
+        }
+
+        memcpy (h, buf, sizeof (float) * keep);
+    }
+}
+
+static void peak4_c (const float * data, int channels, int frames,
+ const float * coefs, int taps, float * hist, float * peak)
+{
+    peak4_common (data, channels, frames, coefs, taps, hist, peak, peak4_kernel_c);
+}
+
+static void cmac_c (float * acc, const float * a, const float * b, int len)
+{
+    for (int i = 0; i < 2 * len; i += 2)
+    {
+        acc[i] += a[i] * b[i] - a[i + 1] * b[i + 1];
+        acc[i + 1] += a[i] * b[i + 1] + a[i + 1] * b[i];
+    }
+}
+
+// The vectorized matrix kernels come in two shapes.  The row kernels, used to
+// mix down to 1, 2 or 4 channels, load whole input frames and compute a group
+// of consecutive output samples as dot products with the matrix rows.  The
+// column kernels, used for everything else up to 8 output channels, build each
+// output frame by adding up the matrix columns scaled by the input samples.
+// Both may read or write a few samples past the end of a frame, so the last
+// frames of a buffer are left to the portable version.
+
+#define MATRIX_MAX_COLUMNS 16
+
+// number of leading frames of <channels> samples each which can be accessed
+// <width> samples at a time without running past the end of the buffer
+static int matrix_safe_frames (int frames, int channels, int width)
+{
+    int safe = frames - (width + channels - 1) / channels + 1;
+    return (safe > 0) ? safe : 0;
+}
+
+#ifdef SIMD_X86
+
+/* ----- SSE2 versions ----- */
+
+TARGET_SSE2 static void ramp_sse2 (float * data, int len, float start, float step)
+{
+    __m128 base = _mm_add_ps (_mm_set1_ps (start),
+     _mm_mul_ps (_mm_set1_ps (step), _mm_setr_ps (0, 1, 2, 3)));
+    __m128 vstep = _mm_set1_ps (step);
+
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        __m128 gain = _mm_add_ps (base, _mm_mul_ps (vstep, _mm_set1_ps ((float) i)));
+        _mm_storeu_ps (data + i, _mm_mul_ps (_mm_loadu_ps (data + i), gain));
+    }
+
+    ramp_c (data + i, len - i, start + step * i, step);
+}
+
+TARGET_SSE2 static void mix_sse2 (float * data, const float * add, int len)
+{
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+        _mm_storeu_ps (data + i, _mm_add_ps (_mm_loadu_ps (data + i), _mm_loadu_ps (add + i)));
+
+    mix_c (data + i, add + i, len - i);
+}
+
+TARGET_SSE2 static void mix_ramp_sse2 (float * data, const float * add, int len, float start, float step)
+{
+    __m128 base = _mm_add_ps (_mm_set1_ps (start),
+     _mm_mul_ps (_mm_set1_ps (step), _mm_setr_ps (0, 1, 2, 3)));
+    __m128 vstep = _mm_set1_ps (step);
+
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        __m128 gain = _mm_add_ps (base, _mm_mul_ps (vstep, _mm_set1_ps ((float) i)));
+        __m128 faded = _mm_mul_ps (_mm_loadu_ps (add + i), gain);
+        _mm_storeu_ps (data + i, _mm_add_ps (_mm_loadu_ps (data + i), faded));
+    }
+
+    mix_ramp_c (data + i, add + i, len - i, start + step * i, step);
+}
+
+TARGET_SSE2 static void mix_mul_sse2 (float * data, const float * add, const float * gain, int len)
+{
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        __m128 faded = _mm_mul_ps (_mm_loadu_ps (add + i), _mm_loadu_ps (gain + i));
+        _mm_storeu_ps (data + i, _mm_add_ps (_mm_loadu_ps (data + i), faded));
+    }
+
+    mix_mul_c (data + i, add + i, gain + i, len - i);
+}
+
+TARGET_SSE2 static float dot_sse2 (const float * a, const float * b, int len)
+{
+    /* two accumulators to hide the latency of the additions */
+    __m128 sum0 = _mm_setzero_ps ();
+    __m128 sum1 = _mm_setzero_ps ();
+
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        sum0 = _mm_add_ps (sum0, _mm_mul_ps (_mm_loadu_ps (a + i), _mm_loadu_ps (b + i)));
+        sum1 = _mm_add_ps (sum1, _mm_mul_ps (_mm_loadu_ps (a + i + 4), _mm_loadu_ps (b + i + 4)));
+    }
+
+    float part[4];
+    _mm_storeu_ps (part, _mm_add_ps (sum0, sum1));
+
+    return part[0] + part[1] + part[2] + part[3] + dot_c (a + i, b + i, len - i);
+}
+
+/* compares the absolute values of four samples against the threshold */
+TARGET_SSE2 static inline int above_mask_sse2 (const float * data, __m128 threshold)
+{
+    __m128 abs_mask = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+    __m128 value = _mm_and_ps (_mm_loadu_ps (data), abs_mask);
+    return _mm_movemask_ps (_mm_cmpgt_ps (value, threshold));
+}
+
+TARGET_SSE2 static int find_above_sse2 (const float * data, int len, float threshold)
+{
+    __m128 vthreshold = _mm_set1_ps (threshold);
+
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        int mask = above_mask_sse2 (data + i, vthreshold);
+        if (mask)
+            return i + __builtin_ctz (mask);
+    }
+
+    int found = find_above_c (data + i, len - i, threshold);
+    return (found < 0) ? -1 : i + found;
+}
+
+TARGET_SSE2 static int rfind_above_sse2 (const float * data, int len, float threshold)
+{
+    __m128 vthreshold = _mm_set1_ps (threshold);
+
+    int i = len;
+    for (; i >= 4; i -= 4)
+    {
+        int mask = above_mask_sse2 (data + i - 4, vthreshold);
+        if (mask)
+            return i - 4 + (31 - __builtin_clz (mask));
+    }
+
+    return rfind_above_c (data, i, threshold);
+}
+
+TARGET_SSE2 static void delay_sse2 (float * data, const float * delayed, float * store,
+ int len, float wet, float feedback)
+{
+    __m128 vwet = _mm_set1_ps (wet);
+    __m128 vfeedback = _mm_set1_ps (feedback);
+
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        __m128 in = _mm_loadu_ps (data + i);
+        __m128 d = _mm_loadu_ps (delayed + i);
+        _mm_storeu_ps (data + i, _mm_add_ps (in, _mm_mul_ps (d, vwet)));
+        _mm_storeu_ps (store + i, _mm_add_ps (in, _mm_mul_ps (d, vfeedback)));
+    }
+
+    delay_c (data + i, delayed + i, store + i, len - i, wet, feedback);
+}
+
+TARGET_SSE2 static void delay_cross_sse2 (float * data, const float * delayed, float * store,
+ int len, float wet, float feedback)
+{
+    __m128 vwet = _mm_set1_ps (wet);
+    __m128 vfeedback = _mm_set1_ps (feedback);
+
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        __m128 in = _mm_loadu_ps (data + i);
+        __m128 d = _mm_loadu_ps (delayed + i);
+        __m128 swapped = _mm_shuffle_ps (d, d, _MM_SHUFFLE (2, 3, 0, 1));
+        _mm_storeu_ps (data + i, _mm_add_ps (in, _mm_mul_ps (d, vwet)));
+        _mm_storeu_ps (store + i, _mm_add_ps (in, _mm_mul_ps (swapped, vfeedback)));
+    }
+
+    delay_cross_c (data + i, delayed + i, store + i, len - i, wet, feedback);
+}
+
+template<int VECS>
+TARGET_SSE2 static inline __m128 matrix_dot_sse2 (const float * frame, const float * row,
+ __m128 mask)
+{
+    if (VECS == 1)
+        return _mm_mul_ps (_mm_and_ps (_mm_loadu_ps (frame), mask), _mm_load_ps (row));
+
+    __m128 lo = _mm_mul_ps (_mm_loadu_ps (frame), _mm_load_ps (row));
+    __m128 hi = _mm_mul_ps (_mm_and_ps (_mm_loadu_ps (frame + 4), mask), _mm_load_ps (row + 4));
+    return _mm_add_ps (lo, hi);
+}
+
+// VECS = vectors per input frame (in_ch <= 4 * VECS), OUT = out_ch (1, 2 or 4)
+template<int VECS, int OUT>
+TARGET_SSE2 static void matrix_rows_sse2 (const float * in, float * out, int frames,
+ int in_ch, int out_ch, const float * matrix)
+{
+    alignas (16) float rows[OUT][8] = {};
+    for (int o = 0; o < OUT; o ++)
+        for (int i = 0; i < in_ch; i ++)
+            rows[o][i] = matrix[o * in_ch + i];
+
+    // the samples past the end of the frame are masked off
+    __m128 mask = _mm_castsi128_ps (_mm_cmplt_epi32 (_mm_setr_epi32 (0, 1, 2, 3),
+     _mm_set1_epi32 (in_ch - 4 * (VECS - 1))));
+
+    const int step = 4 / OUT;  // frames per group of four output samples
+    int groups = matrix_safe_frames (frames, in_ch, 4 * VECS) / step;
+
+    for (int g = 0; g < groups; g ++)
+    {
+        __m128 d0 = matrix_dot_sse2<VECS> (in + (0 / OUT) * in_ch, rows[0 % OUT], mask);
+        __m128 d1 = matrix_dot_sse2<VECS> (in + (1 / OUT) * in_ch, rows[1 % OUT], mask);
+        __m128 d2 = matrix_dot_sse2<VECS> (in + (2 / OUT) * in_ch, rows[2 % OUT], mask);
+        __m128 d3 = matrix_dot_sse2<VECS> (in + (3 / OUT) * in_ch, rows[3 % OUT], mask);
+
+        // transpose and add up the partial sums of each dot product
+        __m128 s01 = _mm_add_ps (_mm_unpacklo_ps (d0, d1), _mm_unpackhi_ps (d0, d1));
+        __m128 s23 = _mm_add_ps (_mm_unpacklo_ps (d2, d3), _mm_unpackhi_ps (d2, d3));
+        _mm_storeu_ps (out, _mm_add_ps (_mm_movelh_ps (s01, s23), _mm_movehl_ps (s23, s01)));
+
+        in += step * in_ch;
+        out += 4;
+    }
+
+    matrix_c (in, out, frames - groups * step, in_ch, OUT, matrix);
+}
+
+// VECS = vectors per output frame (out_ch <= 4 * VECS)
+template<int VECS>
+TARGET_SSE2 static void matrix_columns_sse2 (const float * in, float * out, int frames,
+ int in_ch, int out_ch, const float * matrix)
+{
+    alignas (16) float columns[MATRIX_MAX_COLUMNS][8] = {};
+    for (int o = 0; o < out_ch; o ++)
+        for (int i = 0; i < in_ch; i ++)
+            columns[i][o] = matrix[o * in_ch + i];
+
+    int safe = matrix_safe_frames (frames, out_ch, 4 * VECS);
+
+    for (int f = 0; f < safe; f ++)
+    {
+        __m128 lo = _mm_setzero_ps ();
+        __m128 hi = _mm_setzero_ps ();
+
+        for (int i = 0; i < in_ch; i ++)
+        {
+            __m128 sample = _mm_set1_ps (in[i]);
+            lo = _mm_add_ps (lo, _mm_mul_ps (sample, _mm_load_ps (columns[i])));
+            if (VECS == 2)
+                hi = _mm_add_ps (hi, _mm_mul_ps (sample, _mm_load_ps (columns[i] + 4)));
+        }
+
+        // the extra samples are zeros, overwritten by the next frame
+        _mm_storeu_ps (out, lo);
+        if (VECS == 2)
+            _mm_storeu_ps (out + 4, hi);
+
+        in += in_ch;
+        out += out_ch;
+    }
+
+    matrix_c (in, out, frames - safe, in_ch, out_ch, matrix);
+}
+
+// The stereo filter kernels work on several frames per vector.  Each matrix is
+// applied as the sum of its diagonal times the frames and its antidiagonal
+// times the frames with left and right swapped.
+
+TARGET_SSE2 static void stereo_fir_sse2 (float * data, int frames, const float * a,
+ const float * b, float * prev)
+{
+    __m128 a_diag = _mm_setr_ps (a[0], a[3], a[0], a[3]);
+    __m128 a_anti = _mm_setr_ps (a[1], a[2], a[1], a[2]);
+    __m128 b_diag = _mm_setr_ps (b[0], b[3], b[0], b[3]);
+    __m128 b_anti = _mm_setr_ps (b[1], b[2], b[1], b[2]);
+
+    // the previous frame is kept in the upper half
+    __m128 last = _mm_setr_ps (0, 0, prev[0], prev[1]);
+
+    int n = 0;
+    for (; n + 2 <= frames; n += 2)
+    {
+        __m128 x = _mm_loadu_ps (data + 2 * n);
+        __m128 p = _mm_shuffle_ps (last, x, _MM_SHUFFLE (1, 0, 3, 2));
+
+        __m128 y = _mm_add_ps (_mm_mul_ps (a_diag, x),
+         _mm_mul_ps (a_anti, _mm_shuffle_ps (x, x, _MM_SHUFFLE (2, 3, 0, 1))));
+        y = _mm_add_ps (y, _mm_mul_ps (b_diag, p));
+        y = _mm_add_ps (y, _mm_mul_ps (b_anti, _mm_shuffle_ps (p, p, _MM_SHUFFLE (2, 3, 0, 1))));
+
+        _mm_storeu_ps (data + 2 * n, y);
+        last = x;
+    }
+
+    float tail[4];
+    _mm_storeu_ps (tail, last);
+    prev[0] = tail[2];
+    prev[1] = tail[3];
+
+    stereo_fir_c (data + 2 * n, frames - n, a, b, prev);
+}
+
+// the most common layouts get a kernel of their own
+TARGET_SSE2 static void matrix_2_to_1_sse2 (const float * in, float * out, int frames,
+ int in_ch, int out_ch, const float * matrix)
+{
+    __m128 gain = _mm_setr_ps (matrix[0], matrix[1], matrix[0], matrix[1]);
+
+    int f = 0;
+    for (; f + 4 <= frames; f += 4)
+    {
+        __m128 a = _mm_mul_ps (_mm_loadu_ps (in + 2 * f), gain);
+        __m128 b = _mm_mul_ps (_mm_loadu_ps (in + 2 * f + 4), gain);
+        _mm_storeu_ps (out + f, _mm_add_ps (_mm_shuffle_ps (a, b, _MM_SHUFFLE (2, 0, 2, 0)),
+         _mm_shuffle_ps (a, b, _MM_SHUFFLE (3, 1, 3, 1))));
+    }
+
+    matrix_c (in + 2 * f, out + f, frames - f, 2, 1, matrix);
+}
+
+TARGET_SSE2 static void matrix_1_to_2_sse2 (const float * in, float * out, int frames,
+ int in_ch, int out_ch, const float * matrix)
+{
+    __m128 gain = _mm_setr_ps (matrix[0], matrix[1], matrix[0], matrix[1]);
+
+    int f = 0;
+    for (; f + 4 <= frames; f += 4)
+    {
+        __m128 a = _mm_loadu_ps (in + f);
+        _mm_storeu_ps (out + 2 * f, _mm_mul_ps (_mm_unpacklo_ps (a, a), gain));
+        _mm_storeu_ps (out + 2 * f + 4, _mm_mul_ps (_mm_unpackhi_ps (a, a), gain));
+    }
+
+    matrix_c (in + f, out + 2 * f, frames - f, 1, 2, matrix);
+}
+
+TARGET_SSE2 static SimdMatrixFunc matrix_func_sse2 (int in_ch, int out_ch)
+{
+    if (in_ch == 2 && out_ch == 1)
+        return matrix_2_to_1_sse2;
+    if (in_ch == 1 && out_ch == 2)
+        return matrix_1_to_2_sse2;
+
+    if (in_ch > out_ch && in_ch <= 8)
+    {
+        bool two = (in_ch > 4);
+
+        if (out_ch == 1)
+            return two ? matrix_rows_sse2<2, 1> : matrix_rows_sse2<1, 1>;
+        if (out_ch == 2)
+            return two ? matrix_rows_sse2<2, 2> : matrix_rows_sse2<1, 2>;
+        if (out_ch == 4)
+            return two ? matrix_rows_sse2<2, 4> : matrix_rows_sse2<1, 4>;
+    }
+
+    if (in_ch <= MATRIX_MAX_COLUMNS && out_ch <= 8)
+        return (out_ch > 4) ? matrix_columns_sse2<2> : matrix_columns_sse2<1>;
+
+    return matrix_c;
+}
+
+// The de/interleave kernels move 4 frames at a time, transposing groups of 4
+// channels and then pairs of channels.  Odd channel counts are left to the
+// portable version.
+
+TARGET_SSE2 static void deinterleave_sse2 (const float * data, float * const * bufs,
+ int channels, int frames)
+{
+    int f = 0;
+    if (channels % 2 == 0)
+    {
+        for (; f + 4 <= frames; f += 4)
+        {
+            const float * in = data + f * channels;
+            int c = 0;
+
+            for (; c + 4 <= channels; c += 4)
+            {
+                __m128 r0 = _mm_loadu_ps (in + c);
+                __m128 r1 = _mm_loadu_ps (in + channels + c);
+                __m128 r2 = _mm_loadu_ps (in + 2 * channels + c);
+                __m128 r3 = _mm_loadu_ps (in + 3 * channels + c);
+
+                _MM_TRANSPOSE4_PS (r0, r1, r2, r3);
+
+                _mm_storeu_ps (bufs[c] + f, r0);
+                _mm_storeu_ps (bufs[c + 1] + f, r1);
+                _mm_storeu_ps (bufs[c + 2] + f, r2);
+                _mm_storeu_ps (bufs[c + 3] + f, r3);
+            }
+
+            for (; c < channels; c += 2)
+            {
+                __m128 a = _mm_setzero_ps (), b = _mm_setzero_ps ();
+                a = _mm_loadl_pi (a, (const __m64 *) (in + c));
+                a = _mm_loadh_pi (a, (const __m64 *) (in + channels + c));
+                b = _mm_loadl_pi (b, (const __m64 *) (in + 2 * channels + c));
+                b = _mm_loadh_pi (b, (const __m64 *) (in + 3 * channels + c));
+
+                _mm_storeu_ps (bufs[c] + f, _mm_shuffle_ps (a, b, _MM_SHUFFLE (2, 0, 2, 0)));
+                _mm_storeu_ps (bufs[c + 1] + f, _mm_shuffle_ps (a, b, _MM_SHUFFLE (3, 1, 3, 1)));
+            }
+        }
+    }
+
+    deinterleave_from (data, bufs, channels, f, frames);
+}
+
+TARGET_SSE2 static void interleave_sse2 (float * data, const float * const * bufs,
+ int channels, int frames)
+{
+    int f = 0;
+    if (channels % 2 == 0)
+    {
+        for (; f + 4 <= frames; f += 4)
+        {
+            float * out = data + f * channels;
+            int c = 0;
+
+            for (; c + 4 <= channels; c += 4)
+            {
+                __m128 r0 = _mm_loadu_ps (bufs[c] + f);
+                __m128 r1 = _mm_loadu_ps (bufs[c + 1] + f);
+                __m128 r2 = _mm_loadu_ps (bufs[c + 2] + f);
+                __m128 r3 = _mm_loadu_ps (bufs[c + 3] + f);
+
+                _MM_TRANSPOSE4_PS (r0, r1, r2, r3);
+
+                _mm_storeu_ps (out + c, r0);
+                _mm_storeu_ps (out + channels + c, r1);
+                _mm_storeu_ps (out + 2 * channels + c, r2);
+                _mm_storeu_ps (out + 3 * channels + c, r3);
+            }
+
+            for (; c < channels; c += 2)
+            {
+                __m128 a = _mm_loadu_ps (bufs[c] + f);
+                __m128 b = _mm_loadu_ps (bufs[c + 1] + f);
+                __m128 lo = _mm_unpacklo_ps (a, b);
+                __m128 hi = _mm_unpackhi_ps (a, b);
+
+                _mm_storel_pi ((__m64 *) (out + c), lo);
+                _mm_storeh_pi ((__m64 *) (out + channels + c), lo);
+                _mm_storel_pi ((__m64 *) (out + 2 * channels + c), hi);
+                _mm_storeh_pi ((__m64 *) (out + 3 * channels + c), hi);
+            }
+        }
+    }
+
+    interleave_from (data, bufs, channels, f, frames);
+}
+
+// The biquads are run on pairs of channels, one per double-precision lane.
+// With an odd channel count, the last channel is left to the portable version.
+
+TARGET_SSE2 static void biquad2_power_sse2 (const float * data, int channels,
+ int frames, const double * coefs, double * state, double * power)
+{
+    __m128d f0 = _mm_set1_pd (coefs[0]), f1 = _mm_set1_pd (coefs[1]);
+    __m128d f2 = _mm_set1_pd (coefs[2]), f3 = _mm_set1_pd (coefs[3]);
+    __m128d f4 = _mm_set1_pd (coefs[4]), g0 = _mm_set1_pd (coefs[5]);
+    __m128d g1 = _mm_set1_pd (coefs[6]), g2 = _mm_set1_pd (coefs[7]);
+    __m128d g3 = _mm_set1_pd (coefs[8]), g4 = _mm_set1_pd (coefs[9]);
+
+    int c = 0;
+    for (; c + 2 <= channels; c += 2)
+    {
+        __m128d s0 = _mm_loadu_pd (state + c);
+        __m128d s1 = _mm_loadu_pd (state + channels + c);
+        __m128d s2 = _mm_loadu_pd (state + 2 * channels + c);
+        __m128d s3 = _mm_loadu_pd (state + 3 * channels + c);
+        __m128d sum = _mm_setzero_pd ();
+
+        const float * in = data + c;
+
+        for (int n = 0; n < frames; n ++)
+        {
+            __m128d x = _mm_cvtps_pd (_mm_loadl_pi (_mm_setzero_ps (), (const __m64 *) in));
+            in += channels;
+
+            __m128d y = _mm_add_pd (_mm_mul_pd (f0, x), s0);
+            s0 = _mm_add_pd (_mm_sub_pd (_mm_mul_pd (f1, x), _mm_mul_pd (f3, y)), s1);
+            s1 = _mm_sub_pd (_mm_mul_pd (f2, x), _mm_mul_pd (f4, y));
+
+            __m128d z = _mm_add_pd (_mm_mul_pd (g0, y), s2);
+            s2 = _mm_add_pd (_mm_sub_pd (_mm_mul_pd (g1, y), _mm_mul_pd (g3, z)), s3);
+            s3 = _mm_sub_pd (_mm_mul_pd (g2, y), _mm_mul_pd (g4, z));
+
+            sum = _mm_add_pd (sum, _mm_mul_pd (z, z));
+        }
+
+        _mm_storeu_pd (state + c, s0);
+        _mm_storeu_pd (state + channels + c, s1);
+        _mm_storeu_pd (state + 2 * channels + c, s2);
+        _mm_storeu_pd (state + 3 * channels + c, s3);
+        _mm_storeu_pd (power + c, _mm_add_pd (_mm_loadu_pd (power + c), sum));
+    }
+
+    biquad2_power_from (data, channels, c, frames, coefs, state, power);
+}
+
+// The vectorized peak kernels compute a group of consecutive outputs of each
+// phase at once, sharing one load of the input per tap among the four phases.
+
+TARGET_SSE2 static float peak4_kernel_sse2 (const float * buf, int len,
+ const float * coefs, int taps)
+{
+    __m128 h[PEAK4_MAX_TAPS * 4];
+    for (int i = 0; i < taps * 4; i ++)
+        h[i] = _mm_set1_ps (coefs[i]);
+
+    __m128 sign = _mm_set1_ps (-0.0f);
+    __m128 vpeak = _mm_setzero_ps ();
+
+    int n = 0;
+    for (; n + 4 <= len; n += 4)
+    {
+        __m128 acc0 = _mm_setzero_ps (), acc1 = _mm_setzero_ps ();
+        __m128 acc2 = _mm_setzero_ps (), acc3 = _mm_setzero_ps ();
+
+        const float * x = buf + taps - 1 + n;
+
+        for (int k = 0; k < taps; k ++)
+        {
+            __m128 in = _mm_loadu_ps (x - k);
+            acc0 = _mm_add_ps (acc0, _mm_mul_ps (h[k * 4], in));
+            acc1 = _mm_add_ps (acc1, _mm_mul_ps (h[k * 4 + 1], in));
+            acc2 = _mm_add_ps (acc2, _mm_mul_ps (h[k * 4 + 2], in));
+            acc3 = _mm_add_ps (acc3, _mm_mul_ps (h[k * 4 + 3], in));
+        }
+
+        vpeak = _mm_max_ps (vpeak, _mm_max_ps (_mm_andnot_ps (sign, acc0),
+         _mm_andnot_ps (sign, acc1)));
+        vpeak = _mm_max_ps (vpeak, _mm_max_ps (_mm_andnot_ps (sign, acc2),
+         _mm_andnot_ps (sign, acc3)));
+    }
+
+    vpeak = _mm_max_ps (vpeak, _mm_movehl_ps (vpeak, vpeak));
+    vpeak = _mm_max_ss (vpeak, _mm_shuffle_ps (vpeak, vpeak, _MM_SHUFFLE (1, 1, 1, 1)));
+
+    return fmaxf (_mm_cvtss_f32 (vpeak), peak4_kernel_c (buf + n, len - n, coefs, taps));
+}
+
+TARGET_SSE2 static void peak4_sse2 (const float * data, int channels, int frames,
+ const float * coefs, int taps, float * hist, float * peak)
+{
+    peak4_common (data, channels, frames, coefs, taps, hist, peak, peak4_kernel_sse2);
+}
+
+// two complex numbers at a time; without SSE3's addsub, the sign of the real
+// part's second product is flipped by hand
+TARGET_SSE2 static void cmac_sse2 (float * acc, const float * a, const float * b, int len)
+{
+    __m128 sign = _mm_castsi128_ps (_mm_setr_epi32 (0x80000000, 0, 0x80000000, 0));
+
+    int i = 0;
+    for (; i + 2 <= len; i += 2)
+    {
+        __m128 va = _mm_loadu_ps (a + 2 * i);
+        __m128 vb = _mm_loadu_ps (b + 2 * i);
+
+        __m128 b_re = _mm_shuffle_ps (vb, vb, _MM_SHUFFLE (2, 2, 0, 0));
+        __m128 b_im = _mm_shuffle_ps (vb, vb, _MM_SHUFFLE (3, 3, 1, 1));
+        __m128 a_swap = _mm_shuffle_ps (va, va, _MM_SHUFFLE (2, 3, 0, 1));
+
+        __m128 prod = _mm_add_ps (_mm_mul_ps (va, b_re),
+         _mm_xor_ps (_mm_mul_ps (a_swap, b_im), sign));
+
+        _mm_storeu_ps (acc + 2 * i, _mm_add_ps (_mm_loadu_ps (acc + 2 * i), prod));
+    }
+
+    cmac_c (acc + 2 * i, a + 2 * i, b + 2 * i, len - i);
+}
+
+/* ----- AVX2 versions ----- */
+
+TARGET_AVX2 static void ramp_avx2 (float * data, int len, float start, float step)
+{
+    __m256 base = _mm256_add_ps (_mm256_set1_ps (start),
+     _mm256_mul_ps (_mm256_set1_ps (step), _mm256_setr_ps (0, 1, 2, 3, 4, 5, 6, 7)));
+    __m256 vstep = _mm256_set1_ps (step);
+
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m256 gain = _mm256_add_ps (base, _mm256_mul_ps (vstep, _mm256_set1_ps ((float) i)));
+        _mm256_storeu_ps (data + i, _mm256_mul_ps (_mm256_loadu_ps (data + i), gain));
+    }
+
+    ramp_c (data + i, len - i, start + step * i, step);
+}
+
+TARGET_AVX2 static void mix_avx2 (float * data, const float * add, int len)
+{
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+        _mm256_storeu_ps (data + i, _mm256_add_ps (_mm256_loadu_ps (data + i),
+         _mm256_loadu_ps (add + i)));
+
+    mix_c (data + i, add + i, len - i);
+}
+
+TARGET_AVX2 static void mix_ramp_avx2 (float * data, const float * add, int len, float start, float step)
+{
+    __m256 base = _mm256_add_ps (_mm256_set1_ps (start),
+     _mm256_mul_ps (_mm256_set1_ps (step), _mm256_setr_ps (0, 1, 2, 3, 4, 5, 6, 7)));
+    __m256 vstep = _mm256_set1_ps (step);
+
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m256 gain = _mm256_add_ps (base, _mm256_mul_ps (vstep, _mm256_set1_ps ((float) i)));
+        __m256 faded = _mm256_mul_ps (_mm256_loadu_ps (add + i), gain);
+        _mm256_storeu_ps (data + i, _mm256_add_ps (_mm256_loadu_ps (data + i), faded));
+    }
+
+    mix_ramp_c (data + i, add + i, len - i, start + step * i, step);
+}
+
+TARGET_AVX2 static void mix_mul_avx2 (float * data, const float * add, const float * gain, int len)
+{
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m256 faded = _mm256_mul_ps (_mm256_loadu_ps (add + i), _mm256_loadu_ps (gain + i));
+        _mm256_storeu_ps (data + i, _mm256_add_ps (_mm256_loadu_ps (data + i), faded));
+    }
+
+    mix_mul_c (data + i, add + i, gain + i, len - i);
+}
+
+TARGET_AVX2 static float dot_avx2 (const float * a, const float * b, int len)
+{
+    __m256 sum0 = _mm256_setzero_ps ();
+    __m256 sum1 = _mm256_setzero_ps ();
+
+    int i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        sum0 = _mm256_add_ps (sum0, _mm256_mul_ps (_mm256_loadu_ps (a + i),
+         _mm256_loadu_ps (b + i)));
+        sum1 = _mm256_add_ps (sum1, _mm256_mul_ps (_mm256_loadu_ps (a + i + 8),
+         _mm256_loadu_ps (b + i + 8)));
+    }
+
+    float part[8];
+    _mm256_storeu_ps (part, _mm256_add_ps (sum0, sum1));
+
+    float sum = 0;
+    for (int j = 0; j < 8; j ++)
+        sum += part[j];
+
+    return sum + dot_c (a + i, b + i, len - i);
+}
+
+TARGET_AVX2 static inline int above_mask_avx2 (const float * data, __m256 threshold)
+{
+    __m256 abs_mask = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7fffffff));
+    __m256 value = _mm256_and_ps (_mm256_loadu_ps (data), abs_mask);
+    return _mm256_movemask_ps (_mm256_cmp_ps (value, threshold, _CMP_GT_OQ));
+}
+
+TARGET_AVX2 static int find_above_avx2 (const float * data, int len, float threshold)
+{
+    __m256 vthreshold = _mm256_set1_ps (threshold);
+
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        int mask = above_mask_avx2 (data + i, vthreshold);
+        if (mask)
+            return i + __builtin_ctz (mask);
+    }
+
+    int found = find_above_c (data + i, len - i, threshold);
+    return (found < 0) ? -1 : i + found;
+}
+
+TARGET_AVX2 static int rfind_above_avx2 (const float * data, int len, float threshold)
+{
+    __m256 vthreshold = _mm256_set1_ps (threshold);
+
+    int i = len;
+    for (; i >= 8; i -= 8)
+    {
+        int mask = above_mask_avx2 (data + i - 8, vthreshold);
+        if (mask)
+            return i - 8 + (31 - __builtin_clz (mask));
+    }
+
+    return rfind_above_c (data, i, threshold);
+}
+
+TARGET_AVX2 static void delay_avx2 (float * data, const float * delayed, float * store,
+ int len, float wet, float feedback)
+{
+    __m256 vwet = _mm256_set1_ps (wet);
+    __m256 vfeedback = _mm256_set1_ps (feedback);
+
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m256 in = _mm256_loadu_ps (data + i);
+        __m256 d = _mm256_loadu_ps (delayed + i);
+        _mm256_storeu_ps (data + i, _mm256_add_ps (in, _mm256_mul_ps (d, vwet)));
+        _mm256_storeu_ps (store + i, _mm256_add_ps (in, _mm256_mul_ps (d, vfeedback)));
+    }
+
+    delay_c (data + i, delayed + i, store + i, len - i, wet, feedback);
+}
+
+TARGET_AVX2 static void delay_cross_avx2 (float * data, const float * delayed, float * store,
+ int len, float wet, float feedback)
+{
+    __m256 vwet = _mm256_set1_ps (wet);
+    __m256 vfeedback = _mm256_set1_ps (feedback);
+
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m256 in = _mm256_loadu_ps (data + i);
+        __m256 d = _mm256_loadu_ps (delayed + i);
+        __m256 swapped = _mm256_permute_ps (d, _MM_SHUFFLE (2, 3, 0, 1));
+        _mm256_storeu_ps (data + i, _mm256_add_ps (in, _mm256_mul_ps (d, vwet)));
+        _mm256_storeu_ps (store + i, _mm256_add_ps (in, _mm256_mul_ps (swapped, vfeedback)));
+    }
+
+    delay_cross_c (data + i, delayed + i, store + i, len - i, wet, feedback);
+}
+
+TARGET_AVX2 static void stereo_fir_avx2 (float * data, int frames, const float * a,
+ const float * b, float * prev)
+{
+    __m256 a_diag = _mm256_setr_ps (a[0], a[3], a[0], a[3], a[0], a[3], a[0], a[3]);
+    __m256 a_anti = _mm256_setr_ps (a[1], a[2], a[1], a[2], a[1], a[2], a[1], a[2]);
+    __m256 b_diag = _mm256_setr_ps (b[0], b[3], b[0], b[3], b[0], b[3], b[0], b[3]);
+    __m256 b_anti = _mm256_setr_ps (b[1], b[2], b[1], b[2], b[1], b[2], b[1], b[2]);
+
+    // the previous frame is kept at the top
+    __m256 last = _mm256_setr_ps (0, 0, 0, 0, 0, 0, prev[0], prev[1]);
+
+    int n = 0;
+    for (; n + 4 <= frames; n += 4)
+    {
+        __m256 x = _mm256_loadu_ps (data + 2 * n);
+        __m256 t = _mm256_permute2f128_ps (last, x, 0x21);
+        __m256 p = _mm256_shuffle_ps (t, x, _MM_SHUFFLE (1, 0, 3, 2));
+
+        __m256 y = _mm256_add_ps (_mm256_mul_ps (a_diag, x),
+         _mm256_mul_ps (a_anti, _mm256_permute_ps (x, _MM_SHUFFLE (2, 3, 0, 1))));
+        y = _mm256_add_ps (y, _mm256_mul_ps (b_diag, p));
+        y = _mm256_add_ps (y, _mm256_mul_ps (b_anti, _mm256_permute_ps (p, _MM_SHUFFLE (2, 3, 0, 1))));
+
+        _mm256_storeu_ps (data + 2 * n, y);
+        last = x;
+    }
+
+    float tail[8];
+    _mm256_storeu_ps (tail, last);
+    prev[0] = tail[6];
+    prev[1] = tail[7];
+
+    stereo_fir_c (data + 2 * n, frames - n, a, b, prev);
+}
+
+TARGET_AVX2 static void matrix_columns_avx2 (const float * in, float * out, int frames,
+ int in_ch, int out_ch, const float * matrix)
+{
+    alignas (32) float columns[MATRIX_MAX_COLUMNS][8] = {};
+    for (int o = 0; o < out_ch; o ++)
+        for (int i = 0; i < in_ch; i ++)
+            columns[i][o] = matrix[o * in_ch + i];
+
+    int safe = matrix_safe_frames (frames, out_ch, 8);
+
+    for (int f = 0; f < safe; f ++)
+    {
+        // two sums, to shorten the chain of dependent additions
+        __m256 sum0 = _mm256_setzero_ps ();
+        __m256 sum1 = _mm256_setzero_ps ();
+
+        int i = 0;
+        for (; i + 2 <= in_ch; i += 2)
+        {
+            sum0 = _mm256_add_ps (sum0, _mm256_mul_ps (_mm256_broadcast_ss (in + i),
+             _mm256_load_ps (columns[i])));
+            sum1 = _mm256_add_ps (sum1, _mm256_mul_ps (_mm256_broadcast_ss (in + i + 1),
+             _mm256_load_ps (columns[i + 1])));
+        }
+
+        if (i < in_ch)
+            sum0 = _mm256_add_ps (sum0, _mm256_mul_ps (_mm256_broadcast_ss (in + i),
+             _mm256_load_ps (columns[i])));
+
+        // the extra samples are zeros, overwritten by the next frame
+        _mm256_storeu_ps (out, _mm256_add_ps (sum0, sum1));
+
+        in += in_ch;
+        out += out_ch;
+    }
+
+    matrix_c (in, out, frames - safe, in_ch, out_ch, matrix);
+}
+
+TARGET_AVX2 static float peak4_kernel_avx2 (const float * buf, int len,
+ const float * coefs, int taps)
+{
+    __m256 h[PEAK4_MAX_TAPS * 4];
+    for (int i = 0; i < taps * 4; i ++)
+        h[i] = _mm256_set1_ps (coefs[i]);
+
+    __m256 sign = _mm256_set1_ps (-0.0f);
+    __m256 vpeak = _mm256_setzero_ps ();
+
+    int n = 0;
+    for (; n + 8 <= len; n += 8)
+    {
+        __m256 acc0 = _mm256_setzero_ps (), acc1 = _mm256_setzero_ps ();
+        __m256 acc2 = _mm256_setzero_ps (), acc3 = _mm256_setzero_ps ();
+
+        const float * x = buf + taps - 1 + n;
+
+        for (int k = 0; k < taps; k ++)
+        {
+            __m256 in = _mm256_loadu_ps (x - k);
+            acc0 = _mm256_add_ps (acc0, _mm256_mul_ps (h[k * 4], in));
+            acc1 = _mm256_add_ps (acc1, _mm256_mul_ps (h[k * 4 + 1], in));
+            acc2 = _mm256_add_ps (acc2, _mm256_mul_ps (h[k * 4 + 2], in));
+            acc3 = _mm256_add_ps (acc3, _mm256_mul_ps (h[k * 4 + 3], in));
+        }
+
+        vpeak = _mm256_max_ps (vpeak, _mm256_max_ps (_mm256_andnot_ps (sign, acc0),
+         _mm256_andnot_ps (sign, acc1)));
+        vpeak = _mm256_max_ps (vpeak, _mm256_max_ps (_mm256_andnot_ps (sign, acc2),
+         _mm256_andnot_ps (sign, acc3)));
+    }
+
+    __m128 half = _mm_max_ps (_mm256_castps256_ps128 (vpeak), _mm256_extractf128_ps (vpeak, 1));
+    half = _mm_max_ps (half, _mm_movehl_ps (half, half));
+    half = _mm_max_ss (half, _mm_shuffle_ps (half, half, _MM_SHUFFLE (1, 1, 1, 1)));
+
+    return fmaxf (_mm_cvtss_f32 (half), peak4_kernel_c (buf + n, len - n, coefs, taps));
+}
+
+TARGET_AVX2 static void peak4_avx2 (const float * data, int channels, int frames,
+ const float * coefs, int taps, float * hist, float * peak)
+{
+    peak4_common (data, channels, frames, coefs, taps, hist, peak, peak4_kernel_avx2);
+}
+
+TARGET_AVX2 static void cmac_avx2 (float * acc, const float * a, const float * b, int len)
+{
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        __m256 va = _mm256_loadu_ps (a + 2 * i);
+        __m256 vb = _mm256_loadu_ps (b + 2 * i);
+
+        __m256 b_re = _mm256_moveldup_ps (vb);
+        __m256 b_im = _mm256_movehdup_ps (vb);
+        __m256 a_swap = _mm256_permute_ps (va, _MM_SHUFFLE (2, 3, 0, 1));
+
+        __m256 prod = _mm256_addsub_ps (_mm256_mul_ps (va, b_re), _mm256_mul_ps (a_swap, b_im));
+
+        _mm256_storeu_ps (acc + 2 * i, _mm256_add_ps (_mm256_loadu_ps (acc + 2 * i), prod));
+    }
+
+    cmac_c (acc + 2 * i, a + 2 * i, b + 2 * i, len - i);
+}
+
+TARGET_AVX2 static SimdMatrixFunc matrix_func_avx2 (int in_ch, int out_ch)
+{
+    // the 4-wide row kernels beat 8-wide ones, which need costly horizontal adds
+    if ((in_ch == 1 && out_ch == 2) ||
+     (in_ch > out_ch && in_ch <= 8 && (out_ch == 1 || out_ch == 2 || out_ch == 4)))
+        return matrix_func_sse2 (in_ch, out_ch);
+
+    if (in_ch <= MATRIX_MAX_COLUMNS && out_ch <= 8)
+        return matrix_columns_avx2;
+
+    return matrix_c;
+}
+
+#endif // SIMD_X86
+
+/* ----- dispatch ----- */
+
+struct SimdFuncs
+{
+    void (* ramp) (float * data, int len, float start, float step);
+    void (* mix) (float * data, const float * add, int len);
+    void (* mix_ramp) (float * data, const float * add, int len, float start, float step);
+    void (* mix_mul) (float * data, const float * add, const float * gain, int len);
+    float (* dot) (const float * a, const float * b, int len);
+    int (* find_above) (const float * data, int len, float threshold);
+    int (* rfind_above) (const float * data, int len, float threshold);
+    SimdMatrixFunc (* matrix_func) (int in_ch, int out_ch);
+    void (* stereo_fir) (float * data, int frames, const float * a, const float * b,
+     float * prev);
+    void (* deinterleave) (const float * data, float * const * bufs, int channels,
+     int frames);
+    void (* interleave) (float * data, const float * const * bufs, int channels,
+     int frames);
+    void (* delay) (float * data, const float * delayed, float * store, int len,
+     float wet, float feedback);
+    void (* delay_cross) (float * data, const float * delayed, float * store, int len,
+     float wet, float feedback);
+    void (* biquad2_power) (const float * data, int channels, int frames,
+     const double * coefs, double * state, double * power);
+    void (* peak4) (const float * data, int channels, int frames,
+     const float * coefs, int taps, float * hist, float * peak);
+    void (* cmac) (float * acc, const float * a, const float * b, int len);
+};
+
+static const SimdFuncs funcs_c = {
+    ramp_c,
+    mix_c,
+    mix_ramp_c,
+    mix_mul_c,
+    dot_c,
+    find_above_c,
+    rfind_above_c,
+    matrix_func_c,
+    stereo_fir_c,
+    deinterleave_c,
+    interleave_c,
+    delay_c,
+    delay_cross_c,
+    biquad2_power_c,
+    peak4_c,
+    cmac_c
+};
+
+#ifdef SIMD_X86
+
+static const SimdFuncs funcs_sse2 = {
+    ramp_sse2,
+    mix_sse2,
+    mix_ramp_sse2,
+    mix_mul_sse2,
+    dot_sse2,
+    find_above_sse2,
+    rfind_above_sse2,
+    matrix_func_sse2,
+    stereo_fir_sse2,
+    deinterleave_sse2,
+    interleave_sse2,
+    delay_sse2,
+    delay_cross_sse2,
+    biquad2_power_sse2,
+    peak4_sse2,
+    cmac_sse2
+};
+
+static const SimdFuncs funcs_avx2 = {
+    ramp_avx2,
+    mix_avx2,
+    mix_ramp_avx2,
+    mix_mul_avx2,
+    dot_avx2,
+    find_above_avx2,
+    rfind_above_avx2,
+    matrix_func_avx2,
+    stereo_fir_avx2,
+    deinterleave_sse2,  // limited by memory, not by width
+    interleave_sse2,
+    delay_avx2,
+    delay_cross_avx2,
+    biquad2_power_sse2,  // a recurrence, so wider vectors only help with 4+ channels
+    peak4_avx2,
+    cmac_avx2
+};
+
+#endif
+
+static const SimdFuncs & select_funcs ()
+{
+#ifdef SIMD_X86
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("avx2"))
+        return funcs_avx2;
+    if (__builtin_cpu_supports ("sse2"))
+        return funcs_sse2;
+#endif
+
+    return funcs_c;
+}
+
+static const SimdFuncs & funcs ()
+{
+    static const SimdFuncs & selected = select_funcs ();
+    return selected;
+}
+
+void simd_ramp (float * data, int len, float start, float step)
+    { funcs ().ramp (data, len, start, step); }
+void simd_mix (float * data, const float * add, int len)
+    { funcs ().mix (data, add, len); }
+void simd_mix_ramp (float * data, const float * add, int len, float start, float step)
+    { funcs ().mix_ramp (data, add, len, start, step); }
+void simd_mix_mul (float * data, const float * add, const float * gain, int len)
+    { funcs ().mix_mul (data, add, gain, len); }
+float simd_dot (const float * a, const float * b, int len)
+    { return funcs ().dot (a, b, len); }
+int simd_find_above (const float * data, int len, float threshold)
+    { return funcs ().find_above (data, len, threshold); }
+int simd_rfind_above (const float * data, int len, float threshold)
+    { return funcs ().rfind_above (data, len, threshold); }
+SimdMatrixFunc simd_matrix_func (int in_ch, int out_ch)
+    { return funcs ().matrix_func (in_ch, out_ch); }
+void simd_stereo_fir (float * data, int frames, const float * a, const float * b,
+ float * prev)
+    { funcs ().stereo_fir (data, frames, a, b, prev); }
+void simd_deinterleave (const float * data, float * const * bufs, int channels,
+ int frames)
+    { funcs ().deinterleave (data, bufs, channels, frames); }
+void simd_interleave (float * data, const float * const * bufs, int channels,
+ int frames)
+    { funcs ().interleave (data, bufs, channels, frames); }
+void simd_delay (float * data, const float * delayed, float * store, int len,
+ float wet, float feedback)
+    { funcs ().delay (data, delayed, store, len, wet, feedback); }
+void simd_delay_cross (float * data, const float * delayed, float * store, int len,
+ float wet, float feedback)
+    { funcs ().delay_cross (data, delayed, store, len, wet, feedback); }
+void simd_biquad2_power (const float * data, int channels, int frames,
+ const double * coefs, double * state, double * power)
+    { funcs ().biquad2_power (data, channels, frames, coefs, state, power); }
+void simd_peak4 (const float * data, int channels, int frames,
+ const float * coefs, int taps, float * hist, float * peak)
+    { funcs ().peak4 (data, channels, frames, coefs, taps, hist, peak); }
+void simd_cmac (float * acc, const float * a, const float * b, int len)
+    { funcs ().cmac (acc, a, b, len); }
@@ -0,0 +1,103 @@
+/*
+ * simd.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef DSP_COMMON_SIMD_H
+#define DSP_COMMON_SIMD_H
+
+// Vectorized sample kernels shared by the effect plugins.  On x86, SSE2 and
+// AVX2 versions are compiled alongside the portable ones and the best version
+// supported by the CPU is picked at runtime.  The kernels operate on plain
+// (interleaved or not) float arrays and make no assumptions about alignment.
+
+// data[i] *= start + step * i
+void simd_ramp (float * data, int len, float start, float step);
+
+// data[i] += add[i]
+void simd_mix (float * data, const float * add, int len);
+
+// data[i] += add[i] * (start + step * i)
+void simd_mix_ramp (float * data, const float * add, int len, float start, float step);
+
+// data[i] += add[i] * gain[i]
+void simd_mix_mul (float * data, const float * add, const float * gain, int len);
+
+// returns the sum of a[i] * b[i]
+float simd_dot (const float * a, const float * b, int len);
+
+// index of the first / last sample with fabsf (data[i]) > threshold, or -1;
+// the scan stops as soon as one is found
+int simd_find_above (const float * data, int len, float threshold);
+int simd_rfind_above (const float * data, int len, float threshold);
+
+// Mixes frames of in_ch interleaved channels into frames of out_ch channels:
+// out[o] = sum of matrix[o * in_ch + i] * in[i].  in and out must not overlap.
+// The kernel is specialized for the layout, so it is looked up once by channel
+// counts and then called for each buffer with the same counts.
+typedef void (* SimdMatrixFunc) (const float * in, float * out, int frames,
+ int in_ch, int out_ch, const float * matrix);
+
+SimdMatrixFunc simd_matrix_func (int in_ch, int out_ch);
+
+// filters interleaved stereo frames in place: x[n] = A * x[n] + B * x[n - 1],
+// with A and B given as 2x2 matrices in row order; prev holds the input frame
+// before the first one and is updated to the last input frame
+void simd_stereo_fir (float * data, int frames, const float * a, const float * b,
+ float * prev);
+
+// converts between interleaved frames and one array per channel:
+// bufs[c][f] = data[f * channels + c] and back
+void simd_deinterleave (const float * data, float * const * bufs, int channels,
+ int frames);
+void simd_interleave (float * data, const float * const * bufs, int channels,
+ int frames);
+
+// delay line step: in = data[i], d = delayed[i];
+// data[i] = in + d * wet, store[i] = in + d * feedback
+// (store may be the same array as delayed)
+void simd_delay (float * data, const float * delayed, float * store, int len,
+ float wet, float feedback);
+
+// like simd_delay, but the feedback is taken from the other sample of each
+// interleaved pair: store[i] = in + delayed[i ^ 1] * feedback (len must be even)
+void simd_delay_cross (float * data, const float * delayed, float * store, int len,
+ float wet, float feedback);
+
+// Runs interleaved frames through two cascaded biquad sections, the same for
+// each channel, and adds the energy of each channel's output to power[c].
+// coefs holds b0, b1, b2, a1, a2 of each section (a0 being 1); state holds
+// 4 * channels values (state[k * channels + c]), zeroed to start with, and is
+// updated.  The filters are computed in double precision, as they are used for
+// measurement, where noise from rounding would add up.
+void simd_biquad2_power (const float * data, int channels, int frames,
+ const double * coefs, double * state, double * power);
+
+// Upsamples interleaved frames 4 times with a polyphase FIR and raises peak[c]
+// to the largest absolute value of each channel's output.  coefs holds the
+// filter, taps (at most 16) per phase, as coefs[k * 4 + phase] for the input
+// delayed by k samples; hist holds (taps - 1) * channels values, zeroed to
+// start with, and is updated.
+void simd_peak4 (const float * data, int channels, int frames,
+ const float * coefs, int taps, float * hist, float * peak);
+
+// Complex multiply-accumulate: acc[i] += a[i] * b[i] for len complex numbers,
+// each stored as its real part followed by its imaginary part (as in
+// std::complex<float>).
+void simd_cmac (float * acc, const float * a, const float * b, int len);
+
+#endif // DSP_COMMON_SIMD_H
@@ -0,0 +1,86 @@
+/*
+ * sliding-max.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef DSP_COMMON_SLIDING_MAX_H
+#define DSP_COMMON_SLIDING_MAX_H
+
+#include <stdint.h>
+#include <libaudcore/index.h>
+
+// Maximum of the last <window> values pushed, in O(1) amortized time per
+// value.  Candidates are kept in a monotonic deque: a new value evicts all
+// older values that are not larger than it, since those can never be the
+// maximum again.  The deque is a fixed ring sized by resize(), so push() never
+// allocates.
+
+class SlidingMax
+{
+public:
+    void resize (int window)
+    {
+        int size = 1;
+        while (size < window)
+            size <<= 1;
+
+        m_entries.resize (size);
+        m_mask = size - 1;
+        m_window = window;
+        reset ();
+    }
+
+    void reset ()
+    {
+        m_head = m_count = 0;
+        m_pos = 0;
+    }
+
+    void push (float value)
+    {
+        // drop smaller values from the back
+        while (m_count && m_entries[(m_head + m_count - 1) & m_mask].value <= value)
+            m_count --;
+
+        // drop expired values from the front
+        if (m_count && m_entries[m_head].pos <= m_pos - m_window)
+        {
+            m_head = (m_head + 1) & m_mask;
+            m_count --;
+        }
+
+        m_entries[(m_head + m_count) & m_mask] = {m_pos, value};
+        m_count ++;
+        m_pos ++;
+    }
+
+    float max () const
+        { return m_count ? m_entries[m_head].value : 0.0f; }
+
+private:
+    struct Entry {
+        int64_t pos;
+        float value;
+    };
+
+    Index<Entry> m_entries;
+    int m_mask = 0, m_window = 0;
+    int m_head = 0, m_count = 0;
+    int64_t m_pos = 0;
+};
+
+#endif // DSP_COMMON_SLIDING_MAX_H
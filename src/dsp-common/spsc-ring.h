@@ -0,0 +1,177 @@
+/*
+ * spsc-ring.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef DSP_COMMON_SPSC_RING_H
+#define DSP_COMMON_SPSC_RING_H
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include <libaudcore/index.h>
+
+// Ring buffer for one thread writing and another reading, such as an output
+// plugin's playback thread and the audio callback, with no lock between them.
+// The read and write positions are each stored by one thread only and passed
+// to the other with release/acquire ordering, so neither thread ever waits for
+// the other.  The positions run from 0 to twice the size, so that a full
+// buffer can be told from an empty one.
+//
+// flush() may be called by a thread that takes turns with the writer.  It
+// moves the read position itself; the reader advances it by compare-and-swap,
+// so a read overlapping a flush is dropped rather than undoing the flush.
+
+template<class T>
+class SpscRing
+{
+public:
+    // neither thread may use the buffer during alloc() or destroy()
+    void alloc (int size)
+    {
+        m_data.resize (size);
+        m_size = size;
+        m_read = m_write = 0;
+    }
+
+    void destroy ()
+    {
+        m_data.clear ();
+        m_size = m_read = m_write = 0;
+    }
+
+    int size () const
+        { return m_size; }
+    int len () const
+        { return distance (load (m_read), load (m_write)); }
+    int space () const
+        { return m_size - len (); }
+
+    // writer: copies in as much as there is room for and returns the count
+    int write (const T * data, int count)
+    {
+        int write = m_write;
+        count = aud::min (count, m_size - distance (load (m_read), write));
+
+        int pos = index (write);
+        int part = aud::min (count, m_size - pos);
+
+        memcpy (& m_data[pos], data, sizeof (T) * part);
+        if (count > part)
+            memcpy (& m_data[0], data + part, sizeof (T) * (count - part));
+
+        __atomic_store_n (& m_write, advance (write, count), __ATOMIC_RELEASE);
+        return count;
+    }
+
+    // discards everything written so far
+    void flush ()
+        { __atomic_store_n (& m_read, load (m_write), __ATOMIC_RELEASE); }
+
+    // reader: points <data> at the oldest data and returns how much of it
+    // there is before the end of the buffer; the data may be changed in place
+    int peek (T * & data)
+    {
+        m_peek = load (m_read);
+        data = & m_data[index (m_peek)];
+
+        return aud::min (distance (m_peek, load (m_write)), m_size - index (m_peek));
+    }
+
+    // reader: frees <count> items, which must not be more than peek() returned
+    void discard (int count)
+    {
+        int read = m_peek;
+        m_peek = advance (read, count);
+
+        __atomic_compare_exchange_n (& m_read, & read, m_peek, false,
+         __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    }
+
+    // reader: copies out as much as there is, up to <count>
+    int read (T * data, int count)
+    {
+        int done = 0;
+
+        while (done < count)
+        {
+            T * head;
+            int part = aud::min (peek (head), count - done);
+            if (! part)
+                break;
+
+            memcpy (data + done, head, sizeof (T) * part);
+            discard (part);
+            done += part;
+        }
+
+        return done;
+    }
+
+private:
+    static int load (const int & pos)
+        { return __atomic_load_n (& pos, __ATOMIC_ACQUIRE); }
+
+    int distance (int from, int to) const
+        { return (to >= from) ? to - from : to - from + 2 * m_size; }
+    int advance (int pos, int count) const
+        { return (pos + count < 2 * m_size) ? pos + count : pos + count - 2 * m_size; }
+    int index (int pos) const
+        { return (pos < m_size) ? pos : pos - m_size; }
+
+    Index<T> m_data;
+    int m_size = 0;
+    int m_read = 0, m_write = 0;
+    int m_peek = 0;  // reader only
+};
+
+// Lets the writer sleep until there is room in the buffer.  The reader does
+// not wake it, since that would mean a system call in the audio callback;
+// instead, the writer sleeps for a short time and looks again.  Other threads
+// call wake() to cut the sleep short, for example after a flush or pause.
+
+class SpscWaiter
+{
+public:
+    void wait (int ms)
+    {
+        timespec until;
+        clock_gettime (CLOCK_REALTIME, & until);
+
+        until.tv_nsec += ms * 1000000;
+        until.tv_sec += until.tv_nsec / 1000000000;
+        until.tv_nsec %= 1000000000;
+
+        pthread_mutex_lock (& m_mutex);
+        pthread_cond_timedwait (& m_cond, & m_mutex, & until);
+        pthread_mutex_unlock (& m_mutex);
+    }
+
+    void wake ()
+    {
+        pthread_mutex_lock (& m_mutex);
+        pthread_cond_broadcast (& m_cond);
+        pthread_mutex_unlock (& m_mutex);
+    }
+
+private:
+    pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t m_cond = PTHREAD_COND_INITIALIZER;
+};
+
+#endif // DSP_COMMON_SPSC_RING_H
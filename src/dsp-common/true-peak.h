@@ -0,0 +1,43 @@
+/*
+ * true-peak.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef DSP_COMMON_TRUE_PEAK_H
+#define DSP_COMMON_TRUE_PEAK_H
+
+#define TRUE_PEAK_TAPS 12
+
+// BS.1770-4, Annex 2: the interpolation filter for true-peak measurement, as
+// 4 phases of 12 taps, arranged tap by tap as simd_peak4() takes it.  The
+// interpolated signal lags the input by about 6 samples.
+static const float true_peak_filter[TRUE_PEAK_TAPS * 4] = {
+     0.0017089843750, -0.0291748046875, -0.0189208984375, -0.0083007812500,
+     0.0109863281250,  0.0292968750000,  0.0330810546875,  0.0148925781250,
+    -0.0196533203125, -0.0517578125000, -0.0582275390625, -0.0266113281250,
+     0.0332031250000,  0.0891113281250,  0.1015625000000,  0.0476074218750,
+    -0.0594482421875, -0.1665039062500, -0.2003173828125, -0.1022949218750,
+     0.1373291015625,  0.4650878906250,  0.7797851562500,  0.9721679687500,
+     0.9721679687500,  0.7797851562500,  0.4650878906250,  0.1373291015625,
+    -0.1022949218750, -0.2003173828125, -0.1665039062500, -0.0594482421875,
+     0.0476074218750,  0.1015625000000,  0.0891113281250,  0.0332031250000,
+    -0.0266113281250, -0.0582275390625, -0.0517578125000, -0.0196533203125,
+     0.0148925781250,  0.0330810546875,  0.0292968750000,  0.0109863281250,
+    -0.0083007812500, -0.0189208984375, -0.0291748046875,  0.0017089843750
+};
+
+#endif // DSP_COMMON_TRUE_PEAK_H
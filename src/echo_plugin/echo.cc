@@ -3,7 +3,17 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../dsp-common/cached-setting.h"
+#include "../dsp-common/simd.h"
+
 #define MAX_DELAY 1000
+#define MAX_TAPS 8
+
+enum {
+    ECHO_SINGLE,
+    ECHO_MULTI_TAP,
+    ECHO_PING_PONG
+};
 
 static const char echo_about[] =
  N_("Echo Plugin\n"
@@ -15,19 +25,45 @@ static const char * const echo_defaults[] = {
  "delay", "500",
  "feedback", "50",
  "volume", "50",
+ "mode", "0",
+ "taps", "3",
  nullptr};
 
+static AtomicValue<int> echo_mode, echo_taps, echo_delay;
+static AtomicValue<float> echo_feedback, echo_volume;
+
+static void update_settings ()
+{
+    echo_mode.set (aud_get_int ("echo_plugin", "mode"));
+    echo_taps.set (aud::clamp (aud_get_int ("echo_plugin", "taps"), 2, MAX_TAPS));
+    echo_delay.set (aud_get_int ("echo_plugin", "delay"));
+    echo_feedback.set (aud_get_int ("echo_plugin", "feedback") / 100.0f);
+    echo_volume.set (aud_get_int ("echo_plugin", "volume") / 100.0f);
+}
+
+static const ComboItem mode_list[] = {
+    ComboItem (N_("Single echo"), ECHO_SINGLE),
+    ComboItem (N_("Multi-tap"), ECHO_MULTI_TAP),
+    ComboItem (N_("Ping-pong"), ECHO_PING_PONG)
+};
+
 static const PreferencesWidget echo_widgets[] = {
     WidgetLabel (N_("<b>Echo</b>")),
+    WidgetCombo (N_("Mode:"),
+        WidgetInt ("echo_plugin", "mode", update_settings),
+        {{mode_list}}),
     WidgetSpin (N_("Delay:"),
-        WidgetInt ("echo_plugin", "delay"),
+        WidgetInt ("echo_plugin", "delay", update_settings),
         {0, MAX_DELAY, 10, N_("ms")}),
     WidgetSpin (N_("Feedback:"),
-        WidgetInt ("echo_plugin", "feedback"),
+        WidgetInt ("echo_plugin", "feedback", update_settings),
         {0, 100, 1, "%"}),
     WidgetSpin (N_("Volume:"),
-        WidgetInt ("echo_plugin", "volume"),
-        {0, 100, 1, "%"})
+        WidgetInt ("echo_plugin", "volume", update_settings),
+        {0, 100, 1, "%"}),
+    WidgetSpin (N_("Taps (multi-tap mode):"),
+        WidgetInt ("echo_plugin", "taps", update_settings),
+        {2, MAX_TAPS, 1})
 };
 
 static const PluginPreferences echo_prefs = {{echo_widgets}};
@@ -59,6 +95,7 @@ static int w_ofs;
 bool EchoPlugin::init ()
 {
     aud_config_set_defaults ("echo_plugin", echo_defaults);
+    update_settings ();
     return true;
 }
 
@@ -84,31 +121,93 @@ void EchoPlugin::start (int & channels, int & rate)
     }
 }
 
+/* Returns the longest segment that can be processed in one go without the
+ * region read at distance <dist> behind the write position overlapping the
+ * region being written.  A distance of 0 (or the whole buffer) reads each
+ * sample just before overwriting it, which is safe at any length. */
+static int segment_limit (int dist, int len)
+{
+    if (dist == 0 || dist == len)
+        return len;
+
+    return aud::min (dist, len - dist);
+}
+
+/* Wraps a read position <dist> samples behind the write position. */
+static int read_offset (int dist, int len)
+{
+    int ofs = w_ofs - dist;
+    return (ofs < 0) ? ofs + len : ofs;
+}
+
 Index<float> & EchoPlugin::process (Index<float> & data)
 {
-    int delay = aud_get_int ("echo_plugin", "delay");
-    float feedback = aud_get_int ("echo_plugin", "feedback") / 100.0f;
-    float volume = aud_get_int ("echo_plugin", "volume") / 100.0f;
+    int len = buffer.len ();
+    int mode = echo_mode.get ();
+    int delay = echo_delay.get ();
+    float feedback = echo_feedback.get ();
+    float volume = echo_volume.get ();
 
     int interval = aud::rescale (delay, 1000, echo_rate) * echo_channels;
-    interval = aud::clamp (interval, 0, buffer.len ());  // sanity check
+    interval = aud::clamp (interval, 0, len);  // sanity check
 
-    int r_ofs = w_ofs - interval;
-    if (r_ofs < 0)
-        r_ofs += buffer.len ();
+    int max_segment = segment_limit (interval, len);
 
-    float * end = data.end ();
+    /* ping-pong crosses the feedback between the channels of each pair */
+    bool cross = (mode == ECHO_PING_PONG && echo_channels % 2 == 0);
 
-    for (float * f = data.begin (); f < end; f++)
+    /* multi-tap spreads the taps evenly over the delay time, loudest first;
+     * only the last tap feeds back into the delay line */
+    int taps = (mode == ECHO_MULTI_TAP) ? echo_taps.get () : 1;
+    int tap_dist[MAX_TAPS];
+    float tap_gain[MAX_TAPS];
+    int extra_taps = 0;
+
+    for (int t = 1; t < taps; t ++)
     {
-        float in = * f;
-        float buf = buffer[r_ofs];
+        int dist = aud::rescale (delay * t, 1000 * taps, echo_rate) * echo_channels;
+        if (dist <= 0 || dist >= interval)
+            continue;
+
+        tap_dist[extra_taps] = dist;
+        tap_gain[extra_taps] = volume * (taps - t + 1) / taps;
+        max_segment = aud::min (max_segment, segment_limit (dist, len));
+        extra_taps ++;
+    }
+
+    float wet = volume / taps;
+    float * f = data.begin ();
+    int remain = data.len ();
+
+    while (remain > 0)
+    {
+        int r_ofs = read_offset (interval, len);
+        int tap_ofs[MAX_TAPS];
+
+        /* a segment must not wrap around the end of the buffer */
+        int segment = aud::min (remain, max_segment);
+        segment = aud::min (segment, aud::min (len - w_ofs, len - r_ofs));
+
+        for (int t = 0; t < extra_taps; t ++)
+        {
+            tap_ofs[t] = read_offset (tap_dist[t], len);
+            segment = aud::min (segment, len - tap_ofs[t]);
+        }
+
+        if (cross)
+            simd_delay_cross (f, & buffer[r_ofs], & buffer[w_ofs], segment, wet, feedback);
+        else
+            simd_delay (f, & buffer[r_ofs], & buffer[w_ofs], segment, wet, feedback);
+
+        for (int t = 0; t < extra_taps; t ++)
+            simd_mix_ramp (f, & buffer[tap_ofs[t]], segment, tap_gain[t], 0.0f);
 
-        * f = in + buf * volume;
-        buffer[w_ofs] = in + buf * feedback;
+        f += segment;
+        remain -= segment;
 
-        r_ofs = (r_ofs + 1) % buffer.len ();
-        w_ofs = (w_ofs + 1) % buffer.len ();
+        w_ofs += segment;
+        if (w_ofs == len)
+            w_ofs = 0;
     }
 
     return data;
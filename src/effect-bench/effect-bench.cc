@@ -0,0 +1,592 @@
+/*
+ * Effect Plugin Benchmark for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+/*
+ * The benchmark loads effect plugins directly (without starting the player)
+ * and drives their start/process/finish/flush methods with synthetic audio.
+ * For each combination of sample rate, channel count, and buffer size, it
+ * reports the processing time per input sample, the number of heap allocations
+ * made per call once the plugin has warmed up, and the delay returned by
+ * adjust_delay().  Plugins are run one at a time, or all together as a chain.
+ *
+ * Plugins can be given either as paths or as bare names (e.g. "crossfade"),
+ * in which case they are looked up in the installed effect plugin folder.
+ * Config values are left at the plugin defaults unless set with -o, so that
+ * results are repeatable from one machine to the next.
+ *
+ * With -A, the benchmark doubles as a check that effect plugins do not touch
+ * the heap on the audio path: it fails if any run makes a heap allocation in
+ * process() after warming up.  The final call (to finish()) is not checked.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/runtime.h>
+
+#define DEFAULT_RATE 44100
+#define DEFAULT_CHANNELS 2
+#define DEFAULT_FRAMES 512
+#define DEFAULT_SECONDS 10
+
+#define SOURCE_SECONDS 1  /* length of the looped source signal */
+#define WARMUP_CALLS 8    /* calls excluded from the steady-state figures, */
+#define WARMUP_SECONDS 1  /* and at least this much audio */
+
+enum {
+    SIGNAL_SINE,
+    SIGNAL_NOISE,
+    SIGNAL_MIXED,
+    SIGNAL_SILENCE
+};
+
+struct BenchResult
+{
+    int64_t elapsed_ns = 0;
+    int64_t samples = 0;
+    long calls = 0;
+    long allocs = 0;
+    long first_allocs = 0;
+    long process_allocs = 0;  /* excluding the final call to finish() */
+    int delay_min = 0, delay_max = 0, delay_last = 0;
+    int out_channels = 0, out_rate = 0;
+};
+
+/* ----- allocation counting ----- */
+
+/* With glibc, we can count heap allocations made anywhere in the process
+ * (including in the plugins and the libraries they use) by interposing the
+ * allocator entry points and forwarding them to the real implementation. */
+
+#ifdef __GLIBC__
+
+#define HAVE_ALLOC_COUNT
+
+extern "C" void * __libc_malloc (size_t size);
+extern "C" void * __libc_calloc (size_t nmemb, size_t size);
+extern "C" void * __libc_realloc (void * ptr, size_t size);
+extern "C" void * __libc_memalign (size_t align, size_t size);
+
+static volatile bool alloc_counting;
+static volatile long alloc_count;
+
+static inline void count_alloc ()
+{
+    if (alloc_counting)
+        __sync_fetch_and_add (& alloc_count, 1);
+}
+
+extern "C" void * malloc (size_t size) __THROW
+{
+    count_alloc ();
+    return __libc_malloc (size);
+}
+
+extern "C" void * calloc (size_t nmemb, size_t size) __THROW
+{
+    count_alloc ();
+    return __libc_calloc (nmemb, size);
+}
+
+extern "C" void * realloc (void * ptr, size_t size) __THROW
+{
+    count_alloc ();
+    return __libc_realloc (ptr, size);
+}
+
+extern "C" int posix_memalign (void * * ptr, size_t align, size_t size) __THROW
+{
+    count_alloc ();
+    * ptr = __libc_memalign (align, size);
+    return * ptr ? 0 : ENOMEM;
+}
+
+#endif /* __GLIBC__ */
+
+static void begin_counting ()
+{
+#ifdef HAVE_ALLOC_COUNT
+    alloc_count = 0;
+    alloc_counting = true;
+#endif
+}
+
+static long end_counting ()
+{
+#ifdef HAVE_ALLOC_COUNT
+    alloc_counting = false;
+    return alloc_count;
+#else
+    return 0;
+#endif
+}
+
+/* ----- plugin loading ----- */
+
+static Index<void *> handles;
+static Index<EffectPlugin *> effects;
+static Index<String> names;
+
+static bool load_plugin (const char * arg)
+{
+    StringBuf path = strchr (arg, '/') ? StringBuf (arg) :
+     filename_build ({aud_get_path (AudPath::PluginDir), "Effect",
+     str_concat ({arg, PLUGIN_SUFFIX})});
+
+    void * handle = dlopen (path, RTLD_NOW | RTLD_LOCAL);
+    if (! handle)
+    {
+        AUDERR ("Failed to open %s: %s\n", (const char *) path, dlerror ());
+        return false;
+    }
+
+    auto header = (Plugin *) dlsym (handle, "aud_plugin_instance");
+
+    if (! header || header->magic != _AUD_PLUGIN_MAGIC ||
+     header->version < _AUD_PLUGIN_VERSION_MIN ||
+     header->version > _AUD_PLUGIN_VERSION)
+    {
+        AUDERR ("Not a compatible Audacious plugin: %s\n", (const char *) path);
+        dlclose (handle);
+        return false;
+    }
+
+    if (header->type != PluginType::Effect)
+    {
+        AUDERR ("Not an effect plugin: %s\n", (const char *) path);
+        dlclose (handle);
+        return false;
+    }
+
+    auto effect = (EffectPlugin *) header;
+
+    if (! effect->init ())
+    {
+        AUDERR ("Plugin failed to initialize: %s\n", (const char *) path);
+        dlclose (handle);
+        return false;
+    }
+
+    const char * slash = strrchr (path, '/');
+    StringBuf name = str_copy (slash ? slash + 1 : (const char *) path);
+
+    char * dot = strrchr (name, '.');
+    if (dot)
+        * dot = 0;
+
+    handles.append (handle);
+    effects.append (effect);
+    names.append (String (name));
+
+    return true;
+}
+
+static void unload_plugins ()
+{
+    for (EffectPlugin * effect : effects)
+        effect->cleanup ();
+
+    for (void * handle : handles)
+        dlclose (handle);
+
+    handles.clear ();
+    effects.clear ();
+    names.clear ();
+}
+
+/* ----- synthetic audio ----- */
+
+/* Each channel gets a sine wave at a different (integer) frequency, so that
+ * the one-second source loops seamlessly.  "Mixed" adds low-level noise and
+ * a silent gap in the last quarter second to exercise silence detection. */
+static void generate_source (Index<float> & source, int signal, int channels, int rate)
+{
+    int frames = rate * SOURCE_SECONDS;
+    source.resize (frames * channels);
+
+    uint32_t seed = 1;
+    float * set = source.begin ();
+
+    for (int f = 0; f < frames; f ++)
+    {
+        bool gap = (signal == SIGNAL_MIXED && f >= frames * 3 / 4);
+
+        for (int c = 0; c < channels; c ++)
+        {
+            float sine = sinf (2 * M_PI * 110 * (c + 2) * f / rate);
+
+            seed = seed * 1664525 + 1013904223;
+            float noise = (int32_t) seed / 2147483648.0f;
+
+            switch (signal)
+            {
+            case SIGNAL_SINE:
+                * set ++ = 0.5f * sine;
+                break;
+            case SIGNAL_NOISE:
+                * set ++ = 0.5f * noise;
+                break;
+            case SIGNAL_MIXED:
+                * set ++ = gap ? 0.0f : 0.5f * sine + 0.05f * noise;
+                break;
+            default:
+                * set ++ = 0.0f;
+                break;
+            }
+        }
+    }
+}
+
+static void fill_buffer (Index<float> & data, const Index<float> & source,
+ int channels, int frames, int & pos)
+{
+    int source_frames = source.len () / channels;
+
+    data.resize (0);
+
+    while (frames > 0)
+    {
+        int copy = aud::min (frames, source_frames - pos);
+        data.insert (& source[pos * channels], -1, copy * channels);
+
+        pos = (pos + copy) % source_frames;
+        frames -= copy;
+    }
+}
+
+/* ----- benchmark ----- */
+
+static int64_t time_ns ()
+{
+    timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, & ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* mirrors the order in which the player accumulates effect delays */
+static int chain_delay (EffectPlugin * const * chain, int count)
+{
+    int delay = 0;
+    for (int i = count; i --; )
+        delay = chain[i]->adjust_delay (delay);
+
+    return delay;
+}
+
+static void run_chain (EffectPlugin * const * chain, int count,
+ const Index<float> & source, int channels, int rate, int frames,
+ double seconds, BenchResult & result)
+{
+    int out_channels = channels, out_rate = rate;
+    for (int i = 0; i < count; i ++)
+        chain[i]->start (out_channels, out_rate);
+
+    result.out_channels = out_channels;
+    result.out_rate = out_rate;
+
+    long calls = aud::max ((long) 1, (long) (seconds * rate / frames));
+    long warmup_calls = aud::max ((long) WARMUP_CALLS, (long) WARMUP_SECONDS * rate / frames);
+    int pos = 0;
+
+    Index<float> data;
+
+    for (long call = 0; call < warmup_calls + calls; call ++)
+    {
+        bool last = (call == warmup_calls + calls - 1);
+        bool warmup = (call < warmup_calls);
+
+        fill_buffer (data, source, channels, frames, pos);
+
+        begin_counting ();
+        int64_t start = time_ns ();
+
+        Index<float> * buf = & data;
+        for (int i = 0; i < count; i ++)
+            buf = last ? & chain[i]->finish (* buf, true) : & chain[i]->process (* buf);
+
+        int64_t elapsed = time_ns () - start;
+        long allocs = end_counting ();
+
+        int delay = chain_delay (chain, count);
+
+        if (call == 0)
+            result.first_allocs = allocs;
+
+        if (warmup)
+            continue;
+
+        result.elapsed_ns += elapsed;
+        result.samples += frames * channels;
+        result.calls ++;
+        result.allocs += allocs;
+
+        if (! last)
+            result.process_allocs += allocs;
+
+        if (result.calls == 1)
+            result.delay_min = result.delay_max = delay;
+        else
+        {
+            result.delay_min = aud::min (result.delay_min, delay);
+            result.delay_max = aud::max (result.delay_max, delay);
+        }
+
+        result.delay_last = delay;
+    }
+
+    for (int i = 0; i < count; i ++)
+        chain[i]->flush (true);
+}
+
+static void print_header ()
+{
+    printf ("%-32s %7s %3s %6s %10s %10s %11s %10s %17s\n", "plugin", "rate",
+     "ch", "frames", "output", "ns/sample", "allocs/call", "first-call",
+     "delay min/max/end");
+}
+
+static void print_result (const char * name, int rate, int channels, int frames,
+ const BenchResult & r)
+{
+    StringBuf output = str_printf ("%dx%d", r.out_channels, r.out_rate);
+
+    printf ("%-32s %7d %3d %6d %10s %10.2f %11.3f %10ld %5d/%5d/%5d\n", name,
+     rate, channels, frames, (const char *) output,
+     r.samples ? (double) r.elapsed_ns / r.samples : 0.0,
+     r.calls ? (double) r.allocs / r.calls : 0.0, r.first_allocs,
+     r.delay_min, r.delay_max, r.delay_last);
+}
+
+static bool check_allocs (const char * name, int rate, int channels, int frames,
+ const BenchResult & r)
+{
+    if (! r.process_allocs)
+        return true;
+
+    AUDERR ("%s (%d Hz, %d channels, %d frames): %ld heap allocations in "
+     "process() after warming up.\n", name, rate, channels, frames, r.process_allocs);
+
+    return false;
+}
+
+/* ----- command line ----- */
+
+static const char usage[] =
+ "Usage: effect-bench [options] PLUGIN...\n"
+ "\n"
+ "  -r RATES           sample rates, comma-separated (default 44100)\n"
+ "  -c CHANNELS        channel counts, comma-separated (default 2)\n"
+ "  -b FRAMES          frames per buffer, comma-separated (default 512)\n"
+ "  -t SECONDS         length of audio processed per run (default 10)\n"
+ "  -s SIGNAL          sine, noise, mixed, or silence (default mixed)\n"
+ "  -o SECT:NAME=VAL   set a config value before loading plugins\n"
+ "  -C                 run all plugins together as one chain\n"
+ "  -A                 fail if process() allocates memory after warming up\n"
+ "\n"
+ "PLUGIN is either a path or the name of an installed effect plugin.\n"
+ "Allocation counts are only available on systems using glibc.\n";
+
+static bool parse_list (const char * arg, Index<int> & list, int min, int max)
+{
+    list.resize (0);
+
+    while (* arg)
+    {
+        char * end;
+        long val = strtol (arg, & end, 10);
+
+        if (end == arg || val < min || val > max || (* end && * end != ','))
+            return false;
+
+        list.append (val);
+        arg = (* end == ',') ? end + 1 : end;
+    }
+
+    return list.len () > 0;
+}
+
+static bool parse_config (const char * arg)
+{
+    const char * colon = strchr (arg, ':');
+    const char * equals = colon ? strchr (colon, '=') : nullptr;
+
+    if (! equals || colon == arg || equals == colon + 1)
+        return false;
+
+    aud_set_str (str_copy (arg, colon - arg),
+     str_copy (colon + 1, equals - colon - 1), equals + 1);
+
+    return true;
+}
+
+static int parse_signal (const char * arg)
+{
+    static const char * const signals[] = {"sine", "noise", "mixed", "silence"};
+
+    for (int i = 0; i < aud::n_elems (signals); i ++)
+    {
+        if (! strcmp (arg, signals[i]))
+            return i;
+    }
+
+    return -1;
+}
+
+int main (int argc, char * * argv)
+{
+    Index<int> rates, channel_counts, frame_counts;
+    rates.append (DEFAULT_RATE);
+    channel_counts.append (DEFAULT_CHANNELS);
+    frame_counts.append (DEFAULT_FRAMES);
+
+    double seconds = DEFAULT_SECONDS;
+    int signal = SIGNAL_MIXED;
+    bool as_chain = false;
+    bool strict_allocs = false;
+    bool failed = false;
+    int opt;
+
+    aud_init_paths ();
+
+    while ((opt = getopt (argc, argv, "r:c:b:t:s:o:CAh")) != -1)
+    {
+        bool valid = true;
+
+        switch (opt)
+        {
+        case 'r':
+            valid = parse_list (optarg, rates, 1000, 768000);
+            break;
+        case 'c':
+            valid = parse_list (optarg, channel_counts, 1, AUD_MAX_CHANNELS);
+            break;
+        case 'b':
+            valid = parse_list (optarg, frame_counts, 1, 1 << 20);
+            break;
+        case 't':
+            seconds = strtod (optarg, nullptr);
+            valid = (seconds > 0);
+            break;
+        case 's':
+            signal = parse_signal (optarg);
+            valid = (signal >= 0);
+            break;
+        case 'o':
+            valid = parse_config (optarg);
+            break;
+        case 'C':
+            as_chain = true;
+            break;
+        case 'A':
+            strict_allocs = true;
+            break;
+        default:
+            valid = false;
+            break;
+        }
+
+        if (! valid)
+        {
+            fputs (usage, stderr);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind == argc)
+    {
+        fputs (usage, stderr);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = optind; i < argc; i ++)
+    {
+        if (! load_plugin (argv[i]))
+        {
+            unload_plugins ();
+            return EXIT_FAILURE;
+        }
+    }
+
+#ifndef HAVE_ALLOC_COUNT
+    if (strict_allocs)
+    {
+        AUDERR ("Allocation counting is not supported on this system.\n");
+        unload_plugins ();
+        return EXIT_FAILURE;
+    }
+
+    AUDWARN ("Allocation counting is not supported on this system.\n");
+#endif
+
+    print_header ();
+
+    Index<float> source;
+
+    for (int rate : rates)
+    {
+        for (int channels : channel_counts)
+        {
+            generate_source (source, signal, channels, rate);
+
+            for (int frames : frame_counts)
+            {
+                if (as_chain)
+                {
+                    StringBuf name = index_to_str_list (names, "+");
+
+                    BenchResult result;
+                    run_chain (effects.begin (), effects.len (), source,
+                     channels, rate, frames, seconds, result);
+                    print_result (name, rate, channels, frames, result);
+
+                    if (strict_allocs && ! check_allocs (name, rate, channels, frames, result))
+                        failed = true;
+                }
+                else
+                {
+                    for (int i = 0; i < effects.len (); i ++)
+                    {
+                        BenchResult result;
+                        run_chain (& effects[i], 1, source, channels, rate,
+                         frames, seconds, result);
+                        print_result (names[i], rate, channels, frames, result);
+
+                        if (strict_allocs && ! check_allocs (names[i], rate,
+                         channels, frames, result))
+                            failed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    unload_plugins ();
+    aud_cleanup_paths ();
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
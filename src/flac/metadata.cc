@@ -132,6 +132,24 @@ static void insert_int_tuple_to_vc (FLAC__StreamMetadata * vc_block,
         vc_block->data.vorbis_comment.num_comments, entry, true);
 }
 
+static void insert_gain_tuple_to_vc (FLAC__StreamMetadata * vc_block,
+ const Tuple & tuple, Tuple::Field field, Tuple::Field unit_field,
+ const char * field_name, const char * suffix)
+{
+    FLAC__StreamMetadata_VorbisComment_Entry entry;
+    int unit = tuple.get_int (unit_field);
+
+    if (tuple.get_value_type (field) != Tuple::Int || unit <= 0)
+        return;
+
+    StringBuf str = str_concat ({field_name, "=",
+     double_to_str (tuple.get_int (field) / (double) unit), suffix});
+    entry.entry = (FLAC__byte *) (char *) str;
+    entry.length = strlen(str);
+    FLAC__metadata_object_vorbiscomment_insert_comment(vc_block,
+        vc_block->data.vorbis_comment.num_comments, entry, true);
+}
+
 bool FLACng::write_tuple(const char *filename, VFSFile &file, const Tuple &tuple)
 {
     AUDDBG("Update song tuple.\n");
@@ -169,6 +187,11 @@ bool FLACng::write_tuple(const char *filename, VFSFile &file, const Tuple &tuple
     insert_int_tuple_to_vc(vc_block, tuple, Tuple::Year, "DATE");
     insert_int_tuple_to_vc(vc_block, tuple, Tuple::Track, "TRACKNUMBER");
 
+    insert_gain_tuple_to_vc(vc_block, tuple, Tuple::TrackGain, Tuple::GainDivisor, "REPLAYGAIN_TRACK_GAIN", " dB");
+    insert_gain_tuple_to_vc(vc_block, tuple, Tuple::TrackPeak, Tuple::PeakDivisor, "REPLAYGAIN_TRACK_PEAK", "");
+    insert_gain_tuple_to_vc(vc_block, tuple, Tuple::AlbumGain, Tuple::GainDivisor, "REPLAYGAIN_ALBUM_GAIN", " dB");
+    insert_gain_tuple_to_vc(vc_block, tuple, Tuple::AlbumPeak, Tuple::PeakDivisor, "REPLAYGAIN_ALBUM_PEAK", "");
+
     FLAC__metadata_iterator_insert_block_after(iter, vc_block);
 
     FLAC__metadata_iterator_delete(iter);
@@ -24,18 +24,26 @@
 #include <libaudcore/interface.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
-#include <libaudcore/ringbuf.h>
 #include <libaudcore/runtime.h>
 
 #include <algorithm>
 #include <iterator>
 
 #include <assert.h>
-#include <pthread.h>
 #include <sys/time.h>
 
 #include <jack/jack.h>
 
+#ifdef HAVE_SOXR
+#include <soxr.h>
+#endif
+
+#include "../dsp-common/cached-setting.h"
+#include "../dsp-common/spsc-ring.h"
+
+// how long the playback thread sleeps at a time while the buffer is full
+#define WAIT_TIME 10 // milliseconds
+
 static_assert(std::is_same<jack_default_audio_sample_t, float>::value,
  "JACK must be compiled to use float samples");
 
@@ -53,7 +61,7 @@ public:
         & prefs
     };
 
-    constexpr JACKOutput (RingBuf<float> & buffer) :
+    constexpr JACKOutput (SpscRing<float> & buffer) :
         OutputPlugin (info, 0),
         m_buffer (buffer) {}
 
@@ -77,35 +85,63 @@ public:
 private:
     bool connect_ports (int channels, String & error);
     void generate (jack_nframes_t frames);
+    void wait_freewheel (int samples);
+
+#ifdef HAVE_SOXR
+    bool start_resampler (int jack_rate, String & error);
+    int resample (const float * data, int frames);
+#endif
 
     static void error_cb (const char * error)
         { AUDWARN ("%s\n", error); }
     static int generate_cb (jack_nframes_t frames, void * obj)
         { ((JACKOutput *) obj)->generate (frames); return 0; }
+    static void freewheel_cb (int starting, void * obj)
+        { ((JACKOutput *) obj)->m_freewheeling.set (starting); }
 
     int m_rate = 0, m_channels = 0;
-    bool m_paused = false, m_prebuffer = false;
-
-    int m_last_write_frames = 0;
-    timeval m_last_write_time = timeval ();
+    int m_jack_rate = 0;  // the rate of the audio in m_buffer
     bool m_rate_mismatch = false;
 
-    RingBuf<float> & m_buffer;
+    // shared with generate(), which takes no locks
+    AtomicValue<bool> m_paused, m_prebuffer;
+    AtomicValue<int> m_last_write_frames, m_last_write_time;
+
+    // set while the JACK server is in freewheel mode; m_draining lets
+    // generate() output a short period at the end of the stream
+    AtomicValue<bool> m_freewheeling, m_draining;
+    bool m_started_freewheel = false;
+
+    SpscRing<float> & m_buffer;
+    SpscWaiter m_waiter;
+    SpscWaiter m_data_waiter;  // only used while freewheeling
+
+#ifdef HAVE_SOXR
+    // the audio is resampled when it is written, if the JACK server runs at
+    // another rate
+    soxr_t m_soxr = nullptr;
+    AtomicValue<int> m_soxr_delay;  // output frames
+#endif
 
     jack_client_t * m_client = nullptr;
     jack_port_t * m_ports[AUD_MAX_CHANNELS] = {};
-
-    pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
-    pthread_cond_t m_cond = PTHREAD_COND_INITIALIZER;
 };
 
 // must be separate in order for JACKOutput() to be constexpr
-static RingBuf<float> s_buffer;
+static SpscRing<float> s_buffer;
+
+static CachedSetting<int> s_volume_left ("jack", "volume_left");
+static CachedSetting<int> s_volume_right ("jack", "volume_right");
+
+#ifdef HAVE_SOXR
+static Index<float> s_resampled;
+#endif
 
 EXPORT JACKOutput aud_plugin_instance (s_buffer);
 
 const char * const JACKOutput::defaults[] = {
     "auto_connect", "TRUE",
+    "freewheel", "FALSE",
     "volume_left", "100",
     "volume_right", "100",
     nullptr
@@ -113,7 +149,11 @@ const char * const JACKOutput::defaults[] = {
 
 const PreferencesWidget JACKOutput::widgets[] = {
     WidgetCheck (N_("Automatically connect to output ports"),
-        WidgetBool ("jack", "auto_connect"))
+        WidgetBool ("jack", "auto_connect")),
+    WidgetCheck (N_("Render faster than real time (freewheel mode)"),
+        WidgetBool ("jack", "freewheel")),
+    WidgetLabel (N_("In freewheel mode, the whole JACK graph runs as fast as "
+     "it can\nand nothing can be heard.  Takes effect at the next song."))
 };
 
 const PluginPreferences JACKOutput::prefs = {{widgets}};
@@ -121,6 +161,10 @@ const PluginPreferences JACKOutput::prefs = {{widgets}};
 bool JACKOutput::init ()
 {
     aud_config_set_defaults ("jack", defaults);
+
+    s_volume_left.update ();
+    s_volume_right.update ();
+
     return true;
 }
 
@@ -128,11 +172,22 @@ void JACKOutput::set_volume (StereoVolume v)
 {
     aud_set_int ("jack", "volume_left", v.left);
     aud_set_int ("jack", "volume_right", v.right);
+
+    s_volume_left.set (v.left);
+    s_volume_right.set (v.right);
 }
 
 StereoVolume JACKOutput::get_volume ()
 {
-    return {aud_get_int ("jack", "volume_left"), aud_get_int ("jack", "volume_right")};
+    return {s_volume_left.get (), s_volume_right.get ()};
+}
+
+// milliseconds, wrapping around; only differences are used
+static int time_ms ()
+{
+    timeval now;
+    gettimeofday (& now, nullptr);
+    return (unsigned) ((int64_t) now.tv_sec * 1000 + now.tv_usec / 1000);
 }
 
 bool JACKOutput::connect_ports (int channels, String & error)
@@ -183,9 +238,69 @@ fail:
     return success;
 }
 
+#ifdef HAVE_SOXR
+bool JACKOutput::start_resampler (int jack_rate, String & error)
+{
+    AUDINFO ("Resampling from %d Hz to %d Hz for the JACK server.\n", m_rate, jack_rate);
+
+    soxr_error_t soxr_error;
+    soxr_quality_spec_t q = soxr_quality_spec (SOXR_HQ, 0);
+    soxr_runtime_spec_t r = soxr_runtime_spec (1);
+
+    m_soxr = soxr_create (m_rate, jack_rate, m_channels, & soxr_error, nullptr, & q, & r);
+
+    if (soxr_error)
+    {
+        error = String (str_printf (_("Failed to resample to %d Hz: %s"), jack_rate, soxr_error));
+        return false;
+    }
+
+    m_jack_rate = jack_rate;
+    m_soxr_delay.set (0);
+    return true;
+}
+
+// Resamples up to <frames> frames into the ring buffer, as many as there is
+// room for, and returns the count used.  Passing null data resamples what is
+// left in the resampler at the end of the stream.
+int JACKOutput::resample (const float * data, int frames)
+{
+    int space = m_buffer.space () / m_channels;
+
+    if (! space)
+        return 0;
+
+    s_resampled.resize (space * m_channels);
+
+    size_t frames_used = 0, frames_done = 0;
+    soxr_error_t soxr_error = soxr_process (m_soxr, data, frames,
+     data ? & frames_used : nullptr, s_resampled.begin (), space, & frames_done);
+
+    if (soxr_error)
+    {
+        AUDERR ("%s\n", soxr_error);
+        return frames;
+    }
+
+    m_buffer.write (s_resampled.begin (), frames_done * m_channels);
+    m_soxr_delay.set (soxr_delay (m_soxr));
+
+    if (m_buffer.len () >= m_buffer.size () / 4)
+        m_prebuffer.set (false);
+
+    if (m_freewheeling.get ())
+        m_data_waiter.wake ();
+
+    return data ? frames_used : frames_done;
+}
+#endif
+
 bool JACKOutput::open_audio (int format, int rate, int channels, String & error)
 {
     int buffer_time;
+#ifdef HAVE_SOXR
+    int jack_rate;
+#endif
 
     if (format != FMT_FLOAT)
     {
@@ -217,19 +332,29 @@ bool JACKOutput::open_audio (int format, int rate, int channels, String & error)
         }
     }
 
-    buffer_time = aud_get_int (nullptr, "output_buffer_size");
-    m_buffer.alloc (aud::rescale (buffer_time, 1000, rate) * channels);
-
     m_rate = rate;
     m_channels = channels;
-    m_paused = false;
-    m_prebuffer = true;
+    m_jack_rate = rate;
+
+#ifdef HAVE_SOXR
+    jack_rate = jack_get_sample_rate (m_client);
+    if (jack_rate != rate && ! start_resampler (jack_rate, error))
+        goto fail;
+#endif
 
-    m_last_write_frames = 0;
-    m_last_write_time = timeval ();
+    buffer_time = aud_get_int (nullptr, "output_buffer_size");
+    m_buffer.alloc (aud::rescale (buffer_time, 1000, m_jack_rate) * channels);
+    m_paused.set (false);
+    m_prebuffer.set (true);
+
+    m_last_write_frames.set (0);
     m_rate_mismatch = false;
 
+    m_freewheeling.set (false);
+    m_draining.set (false);
+
     jack_set_process_callback (m_client, generate_cb, this);
+    jack_set_freewheel_callback (m_client, freewheel_cb, this);
 
     if (jack_activate (m_client) != 0)
     {
@@ -237,6 +362,14 @@ bool JACKOutput::open_audio (int format, int rate, int channels, String & error)
         goto fail;
     }
 
+    if (aud_get_bool ("jack", "freewheel"))
+    {
+        if (jack_set_freewheel (m_client, 1) == 0)
+            m_started_freewheel = true;
+        else
+            AUDWARN ("jack_set_freewheel() failed\n");
+    }
+
     if (aud_get_bool ("jack", "auto_connect"))
     {
         if (! connect_ports (channels, error))
@@ -252,21 +385,53 @@ fail:
 
 void JACKOutput::close_audio ()
 {
+    // let generate() return before the client is closed
+    m_freewheeling.set (false);
+    m_data_waiter.wake ();
+
+    if (m_started_freewheel)
+    {
+        jack_set_freewheel (m_client, 0);
+        m_started_freewheel = false;
+    }
+
     if (m_client)
         jack_client_close (m_client);
 
     m_buffer.destroy ();
 
+#ifdef HAVE_SOXR
+    if (m_soxr)
+    {
+        soxr_delete (m_soxr);
+        m_soxr = nullptr;
+    }
+
+    s_resampled.clear ();
+#endif
+
     std::fill (m_ports, std::end (m_ports), nullptr);
     m_client = nullptr;
 }
 
-void JACKOutput::generate (jack_nframes_t frames)
+// While the server is freewheeling, the process thread is not real-time and
+// the graph waits for it, so it waits here for a whole period of audio rather
+// than letting the graph run on through silence.
+void JACKOutput::wait_freewheel (int samples)
 {
-    pthread_mutex_lock (& m_mutex);
+    // the buffer may be shorter than a period
+    samples = aud::min (samples, m_buffer.size ());
 
-    m_last_write_frames = 0;
-    gettimeofday (& m_last_write_time, nullptr);
+    while (m_freewheeling.get () && ! m_draining.get () &&
+     (m_paused.get () || m_buffer.len () < samples))
+        m_data_waiter.wait (WAIT_TIME);
+}
+
+// runs in the real-time thread of JACK, so it must not wait for anything
+// (except in freewheel mode)
+void JACKOutput::generate (jack_nframes_t frames)
+{
+    int written = 0;
 
     float * out[AUD_MAX_CHANNELS];
     for (int i = 0; i < m_channels; i ++)
@@ -274,14 +439,15 @@ void JACKOutput::generate (jack_nframes_t frames)
 
     int jack_rate = jack_get_sample_rate (m_client);
 
-    if (jack_rate != m_rate)
+    // the server rate may have changed since the stream was opened
+    if (jack_rate != m_jack_rate)
     {
         if (! m_rate_mismatch)
         {
             aud_ui_show_error (str_printf (_("The JACK server requires a "
              "sample rate of %d Hz, but Audacious is playing at %d Hz.  Please "
              "use the Sample Rate Converter effect to correct the mismatch."),
-             jack_rate, m_rate));
+             jack_rate, m_jack_rate));
             m_rate_mismatch = true;
         }
 
@@ -290,21 +456,28 @@ void JACKOutput::generate (jack_nframes_t frames)
 
     m_rate_mismatch = false;
 
-    if (m_paused || m_prebuffer)
+    wait_freewheel (frames * m_channels);
+
+    // there is no need to prebuffer while freewheeling
+    if (m_paused.get () || (m_prebuffer.get () && ! m_freewheeling.get ()))
         goto silence;
 
-    while (frames && m_buffer.len ())
+    while (frames)
     {
-        int linear_samples = m_buffer.linear ();
+        float * data;
+        int linear_samples = m_buffer.peek (data);
         assert (linear_samples % m_channels == 0);
 
+        if (! linear_samples)
+            break;
+
         int frames_to_copy = aud::min (frames, (jack_nframes_t) linear_samples / m_channels);
 
-        audio_amplify (& m_buffer[0], m_channels, frames_to_copy, get_volume ());
-        audio_deinterlace (& m_buffer[0], FMT_FLOAT, m_channels,
+        audio_amplify (data, m_channels, frames_to_copy, get_volume ());
+        audio_deinterlace (data, FMT_FLOAT, m_channels,
          (void * const *) out, frames_to_copy);
 
-        m_last_write_frames += frames_to_copy;
+        written += frames_to_copy;
         m_buffer.discard (frames_to_copy * m_channels);
 
         for (int i = 0; i < m_channels; i ++)
@@ -317,94 +490,113 @@ silence:
     for (int i = 0; i < m_channels; i ++)
         std::fill (out[i], out[i] + frames, 0.0);
 
-    pthread_cond_broadcast (& m_cond);
-    pthread_mutex_unlock (& m_mutex);
+    m_last_write_time.set (time_ms ());
+    m_last_write_frames.set (written);
+
+    // the playback thread is not paced while freewheeling
+    if (m_freewheeling.get ())
+        m_waiter.wake ();
 }
 
 void JACKOutput::period_wait ()
 {
-    pthread_mutex_lock (& m_mutex);
-
     while (! m_buffer.space ())
     {
-        m_prebuffer = false;
-        pthread_cond_wait (& m_cond, & m_mutex);
+        m_prebuffer.set (false);
+        m_waiter.wait (WAIT_TIME);
     }
-
-    pthread_mutex_unlock (& m_mutex);
 }
 
 int JACKOutput::write_audio (const void * data, int size)
 {
-    pthread_mutex_lock (& m_mutex);
+#ifdef HAVE_SOXR
+    if (m_soxr)
+    {
+        int frames = size / (sizeof (float) * m_channels);
+        return resample ((const float *) data, frames) * sizeof (float) * m_channels;
+    }
+#endif
 
     int samples = size / sizeof (float);
     assert (samples % m_channels == 0);
 
-    samples = aud::min (samples, m_buffer.space ());
-
-    m_buffer.copy_in ((const float *) data, samples);
+    samples = m_buffer.write ((const float *) data, samples);
 
     if (m_buffer.len () >= m_buffer.size () / 4)
-        m_prebuffer = false;
+        m_prebuffer.set (false);
+
+    if (m_freewheeling.get ())
+        m_data_waiter.wake ();
 
-    pthread_mutex_unlock (& m_mutex);
     return samples * sizeof (float);
 }
 
 void JACKOutput::drain ()
 {
-    pthread_mutex_lock (& m_mutex);
+#ifdef HAVE_SOXR
+    if (m_soxr)
+    {
+        // write out what is left in the resampler
+        do
+            period_wait ();
+        while (resample (nullptr, 0));
+
+        soxr_clear (m_soxr);
+        m_soxr_delay.set (0);
+    }
+#endif
 
-    m_prebuffer = false;
+    m_prebuffer.set (false);
+    m_draining.set (true);
+    m_data_waiter.wake ();
 
-    while (m_buffer.len () || m_last_write_frames)
-        pthread_cond_wait (& m_cond, & m_mutex);
+    while (m_buffer.len () || m_last_write_frames.get ())
+        m_waiter.wait (WAIT_TIME);
 
-    pthread_mutex_unlock (& m_mutex);
+    m_draining.set (false);
 }
 
 int JACKOutput::get_delay ()
 {
-    auto timediff = [] (const timeval & a, const timeval & b) -> int64_t
-        { return 1000 * (int64_t) (b.tv_sec - a.tv_sec) + (b.tv_usec - a.tv_usec) / 1000; };
+    int delay = aud::rescale (m_buffer.len (), m_channels * m_jack_rate, 1000);
 
-    pthread_mutex_lock (& m_mutex);
+#ifdef HAVE_SOXR
+    delay += aud::rescale (m_soxr_delay.get (), m_jack_rate, 1000);
+#endif
 
-    int delay = aud::rescale (m_buffer.len (), m_channels * m_rate, 1000);
+    int last_write_frames = m_last_write_frames.get ();
 
-    if (m_last_write_frames)
+    if (last_write_frames)
     {
-        timeval now;
-        gettimeofday (& now, nullptr);
-
-        int written = aud::rescale (m_last_write_frames, m_rate, 1000);
-        delay += aud::max (written - timediff (m_last_write_time, now), (int64_t) 0);
+        int written = aud::rescale (last_write_frames, m_jack_rate, 1000);
+        int elapsed = (unsigned) time_ms () - (unsigned) m_last_write_time.get ();
+        delay += aud::max (written - elapsed, 0);
     }
 
-    pthread_mutex_unlock (& m_mutex);
     return delay;
 }
 
 void JACKOutput::pause (bool pause)
 {
-    pthread_mutex_lock (& m_mutex);
-    m_paused = pause;
-    pthread_cond_broadcast (& m_cond);
-    pthread_mutex_unlock (& m_mutex);
+    m_paused.set (pause);
+    m_waiter.wake ();
+    m_data_waiter.wake ();
 }
 
 void JACKOutput::flush ()
 {
-    pthread_mutex_lock (& m_mutex);
-
-    m_buffer.discard ();
+    m_buffer.flush ();
 
-    m_prebuffer = true;
+#ifdef HAVE_SOXR
+    if (m_soxr)
+    {
+        soxr_clear (m_soxr);
+        m_soxr_delay.set (0);
+    }
+#endif
 
-    m_last_write_frames = 0;
-    m_last_write_time = timeval ();
+    m_prebuffer.set (true);
+    m_last_write_frames.set (0);
 
-    pthread_cond_broadcast (& m_cond);
-    pthread_mutex_unlock (& m_mutex);
+    m_waiter.wake ();
 }
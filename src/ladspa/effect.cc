@@ -24,8 +24,60 @@
 
 #include <libaudcore/runtime.h>
 
+#include "../dsp-common/simd.h"
+
+/* The audio thread never locks anything.  It reads the enabled plugins from an
+ * immutable chain, which the main thread replaces with an atomic pointer swap.
+ * The audio thread increments chain_epoch when it starts and again when it
+ * stops using the chain, so the epoch is odd while it may hold a pointer to
+ * it.  After a swap, the main thread waits for an odd epoch to change before
+ * deleting the old chain or shutting down any plugin removed from it.  This
+ * relies on the effect callbacks not being called concurrently. */
+
+typedef Index<LoadedPlugin *> Chain;
+
+static Chain * chain;  /* atomic */
+static unsigned chain_epoch;  /* atomic */
+
 static int ladspa_channels, ladspa_rate;
 
+static Chain * enter_chain ()
+{
+    __atomic_add_fetch (& chain_epoch, 1, __ATOMIC_SEQ_CST);
+    return __atomic_load_n (& chain, __ATOMIC_SEQ_CST);
+}
+
+static void leave_chain ()
+{
+    __atomic_add_fetch (& chain_epoch, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Called by the main thread after changing loadeds.  When it returns, the audio
+ * thread is no longer using any plugin that is not in loadeds. */
+void update_chain ()
+{
+    Chain * new_chain = nullptr;
+
+    if (loadeds.len ())
+    {
+        new_chain = new Chain;
+        for (auto & loaded : loadeds)
+            new_chain->append (loaded.get ());
+    }
+
+    Chain * old_chain = __atomic_exchange_n (& chain, new_chain, __ATOMIC_SEQ_CST);
+    unsigned epoch = __atomic_load_n (& chain_epoch, __ATOMIC_SEQ_CST);
+
+    /* at most one buffer's worth of processing */
+    if (epoch & 1)
+    {
+        while (__atomic_load_n (& chain_epoch, __ATOMIC_SEQ_CST) == epoch)
+            g_usleep (100);
+    }
+
+    delete old_chain;
+}
+
 static void start_plugin (LoadedPlugin & loaded)
 {
     if (loaded.active)
@@ -34,7 +86,14 @@ static void start_plugin (LoadedPlugin & loaded)
     loaded.active = 1;
 
     PluginData & plugin = loaded.plugin;
-    const LADSPA_Descriptor & desc = plugin.desc;
+
+    if (! plugin.desc)
+    {
+        AUDERR ("Plugin module is not loaded: %s\n", (const char *) plugin.name);
+        return;
+    }
+
+    const LADSPA_Descriptor & desc = * plugin.desc;
 
     int ports = plugin.in_ports.len ();
 
@@ -53,8 +112,30 @@ static void start_plugin (LoadedPlugin & loaded)
 
     int instances = ladspa_channels / ports;
 
+    /* unless the plugin says otherwise, the output is written over the input */
+    bool in_place = ! LADSPA_IS_INPLACE_BROKEN (desc.Properties);
+
+    loaded.ports.insert (0, plugin.controls.len ());
     loaded.in_bufs.insert (0, ladspa_channels);
-    loaded.out_bufs.insert (0, ladspa_channels);
+
+    if (! in_place)
+        loaded.out_bufs.insert (0, ladspa_channels);
+
+    for (int channel = 0; channel < ladspa_channels; channel ++)
+    {
+        Index<float> & in = loaded.in_bufs[channel];
+        in.insert (0, LADSPA_BUFLEN);
+        loaded.in_ptrs.append (in.begin ());
+
+        if (in_place)
+            loaded.out_ptrs.append (in.begin ());
+        else
+        {
+            Index<float> & out = loaded.out_bufs[channel];
+            out.insert (0, LADSPA_BUFLEN);
+            loaded.out_ptrs.append (out.begin ());
+        }
+    }
 
     for (int i = 0; i < instances; i ++)
     {
@@ -63,19 +144,13 @@ static void start_plugin (LoadedPlugin & loaded)
 
         int controls = plugin.controls.len ();
         for (int c = 0; c < controls; c ++)
-            desc.connect_port (handle, plugin.controls[c].port, & loaded.values[c]);
+            desc.connect_port (handle, plugin.controls[c].port, & loaded.ports[c]);
 
         for (int p = 0; p < ports; p ++)
         {
             int channel = ports * i + p;
-
-            Index<float> & in = loaded.in_bufs[channel];
-            in.insert (0, LADSPA_BUFLEN);
-            desc.connect_port (handle, plugin.in_ports[p], in.begin ());
-
-            Index<float> & out = loaded.out_bufs[channel];
-            out.insert (0, LADSPA_BUFLEN);
-            desc.connect_port (handle, plugin.out_ports[p], out.begin ());
+            desc.connect_port (handle, plugin.in_ports[p], loaded.in_ptrs[channel]);
+            desc.connect_port (handle, plugin.out_ports[p], loaded.out_ptrs[channel]);
         }
 
         if (desc.activate)
@@ -89,50 +164,23 @@ static void run_plugin (LoadedPlugin & loaded, float * data, int samples)
         return;
 
     PluginData & plugin = loaded.plugin;
-    const LADSPA_Descriptor & desc = plugin.desc;
 
     int ports = plugin.in_ports.len ();
     int instances = loaded.instances.len ();
     assert (ports * instances == ladspa_channels);
 
+    /* the values must not change while the plugin is running */
+    int controls = loaded.ports.len ();
+    for (int c = 0; c < controls; c ++)
+        __atomic_load (& loaded.values[c], & loaded.ports[c], __ATOMIC_RELAXED);
+
     while (samples / ladspa_channels > 0)
     {
         int frames = aud::min (samples / ladspa_channels, LADSPA_BUFLEN);
 
-        for (int i = 0; i < instances; i ++)
-        {
-            LADSPA_Handle handle = loaded.instances[i];
-
-            for (int p = 0; p < ports; p ++)
-            {
-                int channel = ports * i + p;
-                float * get = data + channel;
-                float * in = loaded.in_bufs[channel].begin ();
-                float * in_end = in + frames;
-
-                while (in < in_end)
-                {
-                    * in ++ = * get;
-                    get += ladspa_channels;
-                }
-            }
-
-            desc.run (handle, frames);
-
-            for (int p = 0; p < ports; p ++)
-            {
-                int channel = ports * i + p;
-                float * set = data + channel;
-                float * out = loaded.out_bufs[channel].begin ();
-                float * out_end = out + frames;
-
-                while (out < out_end)
-                {
-                    * set = * out ++;
-                    set += ladspa_channels;
-                }
-            }
-        }
+        simd_deinterleave (data, loaded.in_ptrs.begin (), ladspa_channels, frames);
+        run_instances (loaded, frames);
+        simd_interleave (data, loaded.out_ptrs.begin (), ladspa_channels, frames);
 
         data += ladspa_channels * frames;
         samples -= ladspa_channels * frames;
@@ -145,7 +193,7 @@ static void flush_plugin (LoadedPlugin & loaded)
         return;
 
     PluginData & plugin = loaded.plugin;
-    const LADSPA_Descriptor & desc = plugin.desc;
+    const LADSPA_Descriptor & desc = * plugin.desc;
 
     int instances = loaded.instances.len ();
     for (int i = 0; i < instances; i ++)
@@ -159,7 +207,7 @@ static void flush_plugin (LoadedPlugin & loaded)
     }
 }
 
-void shutdown_plugin_locked (LoadedPlugin & loaded)
+void shutdown_plugin (LoadedPlugin & loaded)
 {
     loaded.active = 0;
 
@@ -167,7 +215,7 @@ void shutdown_plugin_locked (LoadedPlugin & loaded)
         return;
 
     PluginData & plugin = loaded.plugin;
-    const LADSPA_Descriptor & desc = plugin.desc;
+    const LADSPA_Descriptor & desc = * plugin.desc;
 
     int instances = loaded.instances.len ();
     for (int i = 0; i < instances; i ++)
@@ -181,61 +229,70 @@ void shutdown_plugin_locked (LoadedPlugin & loaded)
     }
 
     loaded.instances.clear ();
+    loaded.ports.clear ();
     loaded.in_bufs.clear ();
     loaded.out_bufs.clear ();
+    loaded.in_ptrs.clear ();
+    loaded.out_ptrs.clear ();
 }
 
 void LADSPAHost::start (int & channels, int & rate)
 {
-    pthread_mutex_lock (& mutex);
-
-    for (auto & loaded : loadeds)
-        shutdown_plugin_locked (* loaded);
+    if (Chain * current = enter_chain ())
+    {
+        for (LoadedPlugin * loaded : * current)
+            shutdown_plugin (* loaded);
+    }
 
     ladspa_channels = channels;
     ladspa_rate = rate;
 
-    pthread_mutex_unlock (& mutex);
+    leave_chain ();
+
+    start_workers (aud_get_int ("ladspa", "workers"));
 }
 
 Index<float> & LADSPAHost::process (Index<float> & data)
 {
-    pthread_mutex_lock (& mutex);
-
-    for (auto & loaded : loadeds)
+    if (Chain * current = enter_chain ())
     {
-        start_plugin (* loaded);
-        run_plugin (* loaded, data.begin (), data.len ());
+        for (LoadedPlugin * loaded : * current)
+        {
+            start_plugin (* loaded);
+            run_plugin (* loaded, data.begin (), data.len ());
+        }
     }
 
-    pthread_mutex_unlock (& mutex);
+    leave_chain ();
     return data;
 }
 
 bool LADSPAHost::flush (bool force)
 {
-    pthread_mutex_lock (& mutex);
-
-    for (auto & loaded : loadeds)
-        flush_plugin (* loaded);
+    if (Chain * current = enter_chain ())
+    {
+        for (LoadedPlugin * loaded : * current)
+            flush_plugin (* loaded);
+    }
 
-    pthread_mutex_unlock (& mutex);
+    leave_chain ();
     return true;
 }
 
 Index<float> & LADSPAHost::finish (Index<float> & data, bool end_of_playlist)
 {
-    pthread_mutex_lock (& mutex);
-
-    for (auto & loaded : loadeds)
+    if (Chain * current = enter_chain ())
     {
-        start_plugin (* loaded);
-        run_plugin (* loaded, data.begin (), data.len ());
+        for (LoadedPlugin * loaded : * current)
+        {
+            start_plugin (* loaded);
+            run_plugin (* loaded, data.begin (), data.len ());
 
-        if (end_of_playlist)
-            shutdown_plugin_locked (* loaded);
+            if (end_of_playlist)
+                shutdown_plugin (* loaded);
+        }
     }
 
-    pthread_mutex_unlock (& mutex);
+    leave_chain ();
     return data;
 }
@@ -26,7 +26,7 @@ static void get_value (void * user, int row, int column, GValue * value)
     g_return_if_fail (row >= 0 && row < loadeds.len ());
     g_return_if_fail (column == 0);
 
-    g_value_set_string (value, loadeds[row]->plugin.desc.Name);
+    g_value_set_string (value, loadeds[row]->plugin.name);
 }
 
 static bool get_selected (void * user, int row)
@@ -58,8 +58,6 @@ static void shift_rows (void * user, int row, int before)
     if (before == row)
         return;
 
-    pthread_mutex_lock (& mutex);
-
     Index<SmartPtr<LoadedPlugin>> move;
     Index<SmartPtr<LoadedPlugin>> others;
 
@@ -94,7 +92,7 @@ static void shift_rows (void * user, int row, int before)
 
     loadeds.move_from (move, 0, begin, end - begin, false, true);
 
-    pthread_mutex_unlock (& mutex);
+    update_chain ();
 
     if (loaded_list)
         update_loaded_list (loaded_list);
@@ -24,6 +24,7 @@
 
 #include <algorithm>
 
+#include <glib/gstdio.h>
 #include <gmodule.h>
 #include <gtk/gtk.h>
 
@@ -36,11 +37,11 @@
 
 const char * const LADSPAHost::defaults[] = {
  "plugin_count", "0",
+ "workers", "0",
  nullptr};
 
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 String module_path;
-Index<GModule *> modules;
+Index<SmartPtr<ModuleData>> modules;
 Index<SmartPtr<PluginData>> plugins;
 Index<SmartPtr<LoadedPlugin>> loadeds;
 
@@ -104,13 +105,16 @@ static ControlData parse_control (const LADSPA_Descriptor & desc, int port)
     return control;
 }
 
-static void open_plugin (const char * path, const LADSPA_Descriptor & desc)
+static void add_plugin (ModuleData & module, int index, const LADSPA_Descriptor & desc)
 {
-    const char * slash = strrchr (path, G_DIR_SEPARATOR);
+    const char * slash = strrchr (module.path, G_DIR_SEPARATOR);
     g_return_if_fail (slash && slash[1]);
     g_return_if_fail (desc.Label && desc.Name);
 
-    PluginData & plugin = * plugins.append (new PluginData (slash + 1, desc));
+    PluginData & plugin = * plugins.append (new PluginData (module, index,
+     slash + 1, desc.Label, desc.Name));
+
+    plugin.desc = & desc;
 
     for (unsigned i = 0; i < desc.PortCount; i ++)
     {
@@ -125,33 +129,237 @@ static void open_plugin (const char * path, const LADSPA_Descriptor & desc)
     }
 }
 
-static GModule * open_module (const char * path)
+/* Opens a module.  If <scan> is set, the plugins it contains are added to the
+ * list; otherwise the plugins already listed (from the cache) are connected to
+ * their descriptors.  Returns false if the module could not be opened at all;
+ * a library which is not a LADSPA module is not an error (it has no plugins). */
+static bool open_module (ModuleData & module, bool scan)
 {
-    GModule * handle = g_module_open (path, G_MODULE_BIND_LOCAL);
+    GModule * handle = g_module_open (module.path, G_MODULE_BIND_LOCAL);
     if (! handle)
     {
-        AUDERR ("Failed to open module %s: %s\n", path, g_module_error ());
-        return nullptr;
+        AUDERR ("Failed to open module %s: %s\n", (const char *) module.path, g_module_error ());
+        return false;
     }
 
     void * sym;
     if (! g_module_symbol (handle, "ladspa_descriptor", & sym))
     {
-        AUDERR ("Not a valid LADSPA module: %s\n", path);
+        AUDERR ("Not a valid LADSPA module: %s\n", (const char *) module.path);
         g_module_close (handle);
-        return nullptr;
+        return true;
     }
 
+    module.handle = handle;
+
     LADSPA_Descriptor_Function descfun = (LADSPA_Descriptor_Function) sym;
 
-    const LADSPA_Descriptor * desc;
-    for (int i = 0; (desc = descfun (i)); i ++)
-        open_plugin (path, * desc);
+    if (scan)
+    {
+        const LADSPA_Descriptor * desc;
+        for (int i = 0; (desc = descfun (i)); i ++)
+            add_plugin (module, i, * desc);
+
+        return true;
+    }
+
+    for (auto & plugin : plugins)
+    {
+        if (& plugin->module != & module)
+            continue;
+
+        const LADSPA_Descriptor * desc = descfun (plugin->index);
+
+        if (desc && desc->Label && ! strcmp (desc->Label, plugin->label))
+            plugin->desc = desc;
+        else
+            AUDERR ("Module has changed since it was scanned: %s\n", (const char *) module.path);
+    }
+
+    return true;
+}
+
+bool open_plugin (PluginData & plugin)
+{
+    if (! plugin.desc && ! plugin.module.handle)
+        open_module (plugin.module, false);
+
+    return (plugin.desc != nullptr);
+}
+
+/* The plugin cache is a key file with one group per module, named by its full
+ * path.  A group is only used if the size and modification time of the module
+ * still match. */
+
+#define CACHE_VERSION 1
+
+static StringBuf cache_filename ()
+{
+    return filename_build ({aud_get_path (AudPath::UserDir), "ladspa-cache"});
+}
+
+static bool get_int_list (GKeyFile * cache, const char * group, const char * key, Index<int> & list)
+{
+    if (! g_key_file_has_key (cache, group, key, nullptr))
+        return false;
+
+    gsize len = 0;
+    int * values = g_key_file_get_integer_list (cache, group, key, & len, nullptr);
+
+    list.insert (0, len);
+    std::copy (values, values + len, list.begin ());
+
+    g_free (values);
+    return true;
+}
+
+static bool get_double_list (GKeyFile * cache, const char * group, const char * key, Index<double> & list)
+{
+    if (! g_key_file_has_key (cache, group, key, nullptr))
+        return false;
+
+    gsize len = 0;
+    double * values = g_key_file_get_double_list (cache, group, key, & len, nullptr);
+
+    list.insert (0, len);
+    std::copy (values, values + len, list.begin ());
+
+    g_free (values);
+    return true;
+}
+
+static bool load_cached_plugin (GKeyFile * cache, ModuleData & module, int index,
+ Index<SmartPtr<PluginData>> & list)
+{
+    const char * group = module.path;
+    const char * slash = strrchr (group, G_DIR_SEPARATOR);
+
+    CharPtr label (g_key_file_get_string (cache, group, str_printf ("plugin%d_label", index), nullptr));
+    CharPtr name (g_key_file_get_string (cache, group, str_printf ("plugin%d_name", index), nullptr));
+
+    if (! slash || ! label || ! name)
+        return false;
+
+    PluginData & plugin = * list.append (new PluginData (module,
+     g_key_file_get_integer (cache, group, str_printf ("plugin%d_index", index), nullptr),
+     slash + 1, label, name));
+
+    Index<int> ports, toggles;
+    Index<double> mins, maxs, defs;
+
+    if (! get_int_list (cache, group, str_printf ("plugin%d_in_ports", index), plugin.in_ports) ||
+     ! get_int_list (cache, group, str_printf ("plugin%d_out_ports", index), plugin.out_ports) ||
+     ! get_int_list (cache, group, str_printf ("plugin%d_control_ports", index), ports) ||
+     ! get_int_list (cache, group, str_printf ("plugin%d_control_toggles", index), toggles) ||
+     ! get_double_list (cache, group, str_printf ("plugin%d_control_min", index), mins) ||
+     ! get_double_list (cache, group, str_printf ("plugin%d_control_max", index), maxs) ||
+     ! get_double_list (cache, group, str_printf ("plugin%d_control_def", index), defs))
+        return false;
+
+    gsize count = 0;
+    char * * names = g_key_file_get_string_list (cache, group,
+     str_printf ("plugin%d_control_names", index), & count, nullptr);
+
+    bool valid = (names || ! ports.len ()) && (int) count == ports.len () &&
+     toggles.len () == ports.len () && mins.len () == ports.len () &&
+     maxs.len () == ports.len () && defs.len () == ports.len ();
+
+    for (int i = 0; valid && i < ports.len (); i ++)
+    {
+        ControlData & control = plugin.controls.append ();
+        control.port = ports[i];
+        control.name = String (names[i]);
+        control.is_toggle = toggles[i];
+        control.min = mins[i];
+        control.max = maxs[i];
+        control.def = defs[i];
+    }
+
+    g_strfreev (names);
+    return valid;
+}
+
+static bool load_cached_module (GKeyFile * cache, ModuleData & module, GStatBuf & info)
+{
+    const char * group = module.path;
+
+    if (! g_key_file_has_group (cache, group) ||
+     g_key_file_get_int64 (cache, group, "size", nullptr) != (gint64) info.st_size ||
+     g_key_file_get_int64 (cache, group, "mtime", nullptr) != (gint64) info.st_mtime)
+        return false;
+
+    Index<SmartPtr<PluginData>> list;
+    int count = g_key_file_get_integer (cache, group, "plugins", nullptr);
+
+    for (int i = 0; i < count; i ++)
+    {
+        if (! load_cached_plugin (cache, module, i, list))
+            return false;
+    }
+
+    plugins.move_from (list, 0, -1, -1, true, true);
+    return true;
+}
+
+static void save_cached_module (GKeyFile * cache, ModuleData & module, GStatBuf & info)
+{
+    const char * group = module.path;
+
+    /* not allowed in a group name */
+    if (strpbrk (group, "[]\n"))
+        return;
+
+    g_key_file_set_int64 (cache, group, "size", info.st_size);
+    g_key_file_set_int64 (cache, group, "mtime", info.st_mtime);
+
+    int count = 0;
+    for (auto & plugin : plugins)
+    {
+        if (& plugin->module != & module)
+            continue;
+
+        Index<int> ports, toggles;
+        Index<const char *> names;
+        Index<double> mins, maxs, defs;
+
+        for (auto & control : plugin->controls)
+        {
+            ports.append (control.port);
+            toggles.append (control.is_toggle);
+            names.append (control.name);
+            mins.append (control.min);
+            maxs.append (control.max);
+            defs.append (control.def);
+        }
+
+        g_key_file_set_integer (cache, group, str_printf ("plugin%d_index", count), plugin->index);
+        g_key_file_set_string (cache, group, str_printf ("plugin%d_label", count), plugin->label);
+        g_key_file_set_string (cache, group, str_printf ("plugin%d_name", count), plugin->name);
+        g_key_file_set_integer_list (cache, group, str_printf ("plugin%d_in_ports", count),
+         plugin->in_ports.begin (), plugin->in_ports.len ());
+        g_key_file_set_integer_list (cache, group, str_printf ("plugin%d_out_ports", count),
+         plugin->out_ports.begin (), plugin->out_ports.len ());
+        g_key_file_set_integer_list (cache, group, str_printf ("plugin%d_control_ports", count),
+         ports.begin (), ports.len ());
+        g_key_file_set_string_list (cache, group, str_printf ("plugin%d_control_names", count),
+         names.begin (), names.len ());
+        g_key_file_set_integer_list (cache, group, str_printf ("plugin%d_control_toggles", count),
+         toggles.begin (), toggles.len ());
+        g_key_file_set_double_list (cache, group, str_printf ("plugin%d_control_min", count),
+         mins.begin (), mins.len ());
+        g_key_file_set_double_list (cache, group, str_printf ("plugin%d_control_max", count),
+         maxs.begin (), maxs.len ());
+        g_key_file_set_double_list (cache, group, str_printf ("plugin%d_control_def", count),
+         defs.begin (), defs.len ());
+
+        count ++;
+    }
 
-    return handle;
+    g_key_file_set_integer (cache, group, "plugins", count);
 }
 
-static void open_modules_for_path (const char * path)
+static void open_modules_for_path (const char * path, GKeyFile * old_cache,
+ GKeyFile * new_cache, bool & changed)
 {
     GDir * folder = g_dir_open (path, 0, nullptr);
     if (! folder)
@@ -166,16 +374,34 @@ static void open_modules_for_path (const char * path)
         if (! str_has_suffix_nocase (name, G_MODULE_SUFFIX))
             continue;
 
-        GModule * handle = open_module (filename_build ({path, name}));
+        StringBuf filename = filename_build ({path, name});
+
+        GStatBuf info;
+        if (g_stat (filename, & info) < 0)
+        {
+            AUDERR ("Failed to read module %s: %s\n", (const char *) filename, strerror (errno));
+            continue;
+        }
 
-        if (handle)
-            modules.append (handle);
+        ModuleData & module = * modules.append (new ModuleData (filename));
+
+        if (! load_cached_module (old_cache, module, info))
+        {
+            changed = true;
+
+            /* if the module failed to open, try again next time */
+            if (! open_module (module, true))
+                continue;
+        }
+
+        save_cached_module (new_cache, module, info);
     }
 
     g_dir_close (folder);
 }
 
-static void open_modules_for_paths (const char * paths)
+static void open_modules_for_paths (const char * paths, GKeyFile * old_cache,
+ GKeyFile * new_cache, bool & changed)
 {
     if (! paths || ! paths[0])
         return;
@@ -183,26 +409,66 @@ static void open_modules_for_paths (const char * paths)
     char * * split = g_strsplit (paths, ":", -1);
 
     for (int i = 0; split[i]; i ++)
-        open_modules_for_path (split[i]);
+        open_modules_for_path (split[i], old_cache, new_cache, changed);
 
     g_strfreev (split);
 }
 
+/* Modules found in the cache are not opened here, see open_plugin(). */
 static void open_modules ()
 {
-    open_modules_for_paths (getenv ("LADSPA_PATH"));
-    open_modules_for_paths (module_path);
+    StringBuf filename = cache_filename ();
+
+    GKeyFile * old_cache = g_key_file_new ();
+    GKeyFile * new_cache = g_key_file_new ();
+
+    if (g_key_file_load_from_file (old_cache, filename, G_KEY_FILE_NONE, nullptr) &&
+     g_key_file_get_integer (old_cache, "cache", "version", nullptr) != CACHE_VERSION)
+    {
+        g_key_file_free (old_cache);
+        old_cache = g_key_file_new ();
+    }
+
+    g_key_file_set_integer (new_cache, "cache", "version", CACHE_VERSION);
+
+    bool changed = false;
+    open_modules_for_paths (getenv ("LADSPA_PATH"), old_cache, new_cache, changed);
+    open_modules_for_paths (module_path, old_cache, new_cache, changed);
+
+    /* modules may also have been removed */
+    gsize old_groups = 0, new_groups = 0;
+    g_strfreev (g_key_file_get_groups (old_cache, & old_groups));
+    g_strfreev (g_key_file_get_groups (new_cache, & new_groups));
+
+    if (changed || old_groups != new_groups)
+    {
+        gsize len = 0;
+        CharPtr data (g_key_file_to_data (new_cache, & len, nullptr));
+        GError * error = nullptr;
+
+        if (! g_file_set_contents (filename, data, len, & error))
+        {
+            AUDERR ("Failed to write %s: %s\n", (const char *) filename, error->message);
+            g_error_free (error);
+        }
+    }
+
+    g_key_file_free (old_cache);
+    g_key_file_free (new_cache);
 }
 
 static void close_modules ()
 {
     plugins.clear ();
 
-    for (GModule * module : modules)
-        g_module_close (module);
+    for (auto & module : modules)
+    {
+        if (module->handle)
+            g_module_close (module->handle);
+    }
 }
 
-LoadedPlugin & enable_plugin_locked (PluginData & plugin)
+LoadedPlugin & enable_plugin (PluginData & plugin)
 {
     LoadedPlugin & loaded = * loadeds.append (new LoadedPlugin (plugin));
 
@@ -212,19 +478,31 @@ LoadedPlugin & enable_plugin_locked (PluginData & plugin)
     return loaded;
 }
 
-void disable_plugin_locked (LoadedPlugin & loaded)
+/* The plugin must already have been removed from the chain. */
+void disable_plugin (LoadedPlugin & loaded)
 {
     if (loaded.settings_win)
         gtk_widget_destroy (loaded.settings_win);
 
-    shutdown_plugin_locked (loaded);
+    shutdown_plugin (loaded);
+}
+
+static void disable_all ()
+{
+    Index<SmartPtr<LoadedPlugin>> removed;
+    removed.move_from (loadeds, 0, 0, -1, true, true);
+
+    update_chain ();
+
+    for (auto & loaded : removed)
+        disable_plugin (* loaded);
 }
 
 static PluginData * find_plugin (const char * path, const char * label)
 {
     for (auto & plugin : plugins)
     {
-        if (! strcmp (plugin->path, path) && ! strcmp (plugin->desc.Label, label))
+        if (! strcmp (plugin->path, path) && ! strcmp (plugin->label, label))
             return plugin.get ();
     }
 
@@ -242,7 +520,7 @@ static void save_enabled_to_config ()
         LoadedPlugin & loaded = * loadeds[i];
 
         aud_set_str ("ladspa", str_printf ("plugin%d_path", i), loaded.plugin.path);
-        aud_set_str ("ladspa", str_printf ("plugin%d_label", i), loaded.plugin.desc.Label);
+        aud_set_str ("ladspa", str_printf ("plugin%d_label", i), loaded.plugin.label);
 
         Index<double> temp;
         temp.insert (0, loaded.values.len ());
@@ -250,12 +528,8 @@ static void save_enabled_to_config ()
 
         aud_set_str ("ladspa", str_printf ("plugin%d_controls", i),
          double_array_to_str (temp.begin (), temp.len ()));
-
-        disable_plugin_locked (loaded);
     }
 
-    loadeds.clear ();
-
     for (int i = count; i < old_count; i ++)
     {
         aud_set_str ("ladspa", str_printf ("plugin%d_path", i), "");
@@ -274,10 +548,10 @@ static void load_enabled_from_config ()
         String label = aud_get_str ("ladspa", str_printf ("plugin%d_label", i));
 
         PluginData * plugin = find_plugin (path, label);
-        if (! plugin)
+        if (! plugin || ! open_plugin (* plugin))
             continue;
 
-        LoadedPlugin & loaded = enable_plugin_locked (* plugin);
+        LoadedPlugin & loaded = enable_plugin (* plugin);
 
         String controls = aud_get_str ("ladspa", str_printf ("plugin%d_controls", i));
 
@@ -301,49 +575,42 @@ static void load_enabled_from_config ()
 
 bool LADSPAHost::init ()
 {
-    pthread_mutex_lock (& mutex);
-
     aud_config_set_defaults ("ladspa", defaults);
 
     module_path = aud_get_str ("ladspa", "module_path");
 
     open_modules ();
     load_enabled_from_config ();
+    update_chain ();
 
-    pthread_mutex_unlock (& mutex);
     return true;
 }
 
 void LADSPAHost::cleanup ()
 {
-    pthread_mutex_lock (& mutex);
-
     aud_set_str ("ladspa", "module_path", module_path);
     save_enabled_to_config ();
+    disable_all ();
     close_modules ();
+    stop_workers ();
 
     modules.clear ();
     plugins.clear ();
-    loadeds.clear ();
 
     module_path = String ();
-
-    pthread_mutex_unlock (& mutex);
 }
 
 static void set_module_path (GtkEntry * entry)
 {
-    pthread_mutex_lock (& mutex);
-
     save_enabled_to_config ();
+    disable_all ();
     close_modules ();
 
     module_path = String (gtk_entry_get_text (entry));
 
     open_modules ();
     load_enabled_from_config ();
-
-    pthread_mutex_unlock (& mutex);
+    update_chain ();
 
     if (plugin_list)
         update_plugin_list (plugin_list);
@@ -353,15 +620,13 @@ static void set_module_path (GtkEntry * entry)
 
 static void enable_selected ()
 {
-    pthread_mutex_lock (& mutex);
-
     for (auto & plugin : plugins)
     {
-        if (plugin->selected)
-            enable_plugin_locked (* plugin);
+        if (plugin->selected && open_plugin (* plugin))
+            enable_plugin (* plugin);
     }
 
-    pthread_mutex_unlock (& mutex);
+    update_chain ();
 
     if (loaded_list)
         update_loaded_list (loaded_list);
@@ -369,37 +634,39 @@ static void enable_selected ()
 
 static void disable_selected ()
 {
-    pthread_mutex_lock (& mutex);
+    Index<SmartPtr<LoadedPlugin>> removed;
 
-    for (int i = 0; i < loadeds.len (); i ++)
+    for (int i = 0; i < loadeds.len ();)
     {
         if (loadeds[i]->selected)
         {
-            disable_plugin_locked (* loadeds[i]);
+            removed.append (std::move (loadeds[i]));
             loadeds.remove (i, 1);
         }
         else
             i ++;
     }
 
-    pthread_mutex_unlock (& mutex);
+    update_chain ();
+
+    for (auto & loaded : removed)
+        disable_plugin (* loaded);
 
     if (loaded_list)
         update_loaded_list (loaded_list);
 }
 
+/* picked up by the audio thread before the next run */
 static void control_toggled (GtkToggleButton * toggle, float * value)
 {
-    pthread_mutex_lock (& mutex);
-    * value = gtk_toggle_button_get_active (toggle) ? 1 : 0;
-    pthread_mutex_unlock (& mutex);
+    float new_value = gtk_toggle_button_get_active (toggle) ? 1 : 0;
+    __atomic_store (value, & new_value, __ATOMIC_RELAXED);
 }
 
 static void control_changed (GtkSpinButton * spin, float * value)
 {
-    pthread_mutex_lock (& mutex);
-    * value = gtk_spin_button_get_value (spin);
-    pthread_mutex_unlock (& mutex);
+    float new_value = gtk_spin_button_get_value (spin);
+    __atomic_store (value, & new_value, __ATOMIC_RELAXED);
 }
 
 static void configure_plugin (LoadedPlugin & loaded)
@@ -412,7 +679,7 @@ static void configure_plugin (LoadedPlugin & loaded)
 
     PluginData & plugin = loaded.plugin;
 
-    StringBuf title = str_printf (_("%s Settings"), plugin.desc.Name);
+    StringBuf title = str_printf (_("%s Settings"), (const char *) plugin.name);
     loaded.settings_win = gtk_dialog_new_with_buttons (title, nullptr,
      (GtkDialogFlags) 0, _("_Close"), GTK_RESPONSE_CLOSE, nullptr);
     gtk_window_set_resizable ((GtkWindow *) loaded.settings_win, 0);
@@ -457,15 +724,11 @@ static void configure_plugin (LoadedPlugin & loaded)
 
 static void configure_selected ()
 {
-    pthread_mutex_lock (& mutex);
-
     for (auto & loaded : loadeds)
     {
         if (loaded->selected)
             configure_plugin (* loaded);
     }
-
-    pthread_mutex_unlock (& mutex);
 }
 
 static void * make_config_widget ()
@@ -555,7 +818,10 @@ const char LADSPAHost::about[] =
     "Copyright 2011 John Lindgren");
 
 const PreferencesWidget LADSPAHost::widgets[] = {
-    WidgetCustomGTK (make_config_widget)
+    WidgetCustomGTK (make_config_widget),
+    WidgetSpin (N_("Worker threads for multichannel audio:"),
+        WidgetInt ("ladspa", "workers"),
+        {0, LADSPA_MAX_WORKERS, 1})
 };
 
 const PluginPreferences LADSPAHost::prefs = {{widgets}};
@@ -20,7 +20,7 @@
 #ifndef AUD_LADSPA_PLUGIN_H
 #define AUD_LADSPA_PLUGIN_H
 
-#include <pthread.h>
+#include <gmodule.h>
 #include <gtk/gtk.h>
 
 #include <libaudcore/i18n.h>
@@ -29,6 +29,7 @@
 #include "ladspa.h"
 
 #define LADSPA_BUFLEN 1024
+#define LADSPA_MAX_WORKERS 16
 
 struct PreferencesWidget;
 
@@ -39,27 +40,49 @@ struct ControlData {
     float min, max, def;
 };
 
-struct PluginData
+struct ModuleData
 {
     String path;
-    const LADSPA_Descriptor & desc;
+    GModule * handle = nullptr;
+
+    ModuleData (const char * path) :
+        path (path) {}
+};
+
+/* The plugin metadata comes either from the descriptor or from the cache.  In
+ * the latter case, the module is only opened (and desc set) when the plugin is
+ * actually used. */
+
+struct PluginData
+{
+    ModuleData & module;
+    int index;  /* of the descriptor within the module */
+    String path;  /* file name of the module */
+    String label, name;
+    const LADSPA_Descriptor * desc = nullptr;
     Index<ControlData> controls;
     Index<int> in_ports, out_ports;
     bool selected = false;
 
-    PluginData (const char * path, const LADSPA_Descriptor & desc) :
+    PluginData (ModuleData & module, int index, const char * path,
+     const char * label, const char * name) :
+        module (module),
+        index (index),
         path (path),
-        desc (desc) {}
+        label (label),
+        name (name) {}
 };
 
 struct LoadedPlugin
 {
     PluginData & plugin;
-    Index<float> values;
+    Index<float> values;  /* written atomically by the main thread */
+    Index<float> ports;  /* copy of values connected to the plugin */
     bool selected = false;
     bool active = false;
     Index<LADSPA_Handle> instances;
-    Index<Index<float>> in_bufs, out_bufs;
+    Index<Index<float>> in_bufs, out_bufs;  /* out_bufs unused if in place */
+    Index<float *> in_ptrs, out_ptrs;  /* one per channel */
     GtkWidget * settings_win = nullptr;
 
     LoadedPlugin (PluginData & plugin) :
@@ -94,25 +117,31 @@ public:
 
 /* plugin.c */
 
-/* The mutex needs to be locked when the main thread is writing to the data
- * structures below (but not when it is only reading from them) and when the
- * audio thread is reading from them. */
+/* The data structures below belong to the main thread.  The audio thread only
+ * sees the enabled plugins through the chain published by update_chain(). */
 
-extern pthread_mutex_t mutex;
 extern String module_path;
-extern Index<GModule *> modules;
+extern Index<SmartPtr<ModuleData>> modules;
 extern Index<SmartPtr<PluginData>> plugins;
 extern Index<SmartPtr<LoadedPlugin>> loadeds;
 
 extern GtkWidget * plugin_list;
 extern GtkWidget * loaded_list;
 
-LoadedPlugin & enable_plugin_locked (PluginData & plugin);
-void disable_plugin_locked (LoadedPlugin & loaded);
+bool open_plugin (PluginData & plugin);
+LoadedPlugin & enable_plugin (PluginData & plugin);
+void disable_plugin (LoadedPlugin & loaded);
 
 /* effect.c */
 
-void shutdown_plugin_locked (LoadedPlugin & loaded);
+void update_chain ();
+void shutdown_plugin (LoadedPlugin & loaded);
+
+/* workers.c */
+
+void start_workers (int count);
+void stop_workers ();
+void run_instances (LoadedPlugin & loaded, int frames);
 
 /* plugin-list.c */
 
@@ -0,0 +1,199 @@
+/*
+ * LADSPA Host for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+#include "plugin.h"
+
+#include <libaudcore/runtime.h>
+
+/* The instances of a plugin each process their own channels, so they can run
+ * concurrently.  The audio thread publishes a job, the worker threads and the
+ * audio thread itself take the instances one at a time, and the audio thread
+ * waits until all are done.
+ *
+ * The audio thread never takes a lock: the instances are handed out with an
+ * atomic counter, and it only wakes the workers that have gone to sleep if it
+ * can do so without waiting (otherwise it runs their share itself).  It does
+ * have to wait for the instances that are running on other threads, which it
+ * does by spinning, since each takes no longer than it would to run it here.
+ * The workers are only started and stopped by the audio thread (or by the
+ * main thread once playback is over). */
+
+/* how many times an idle worker looks for work before going to sleep */
+#define SPIN_COUNT 100
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_t workers[LADSPA_MAX_WORKERS];
+static int worker_count;
+static bool quit;
+static int sleeping;
+
+/* The serial number of the job, the number of instances and the next one to
+ * be run are kept in one word, so that an instance is only taken if the job
+ * it belongs to is still the current one. */
+static uint64_t job_state;
+static LoadedPlugin * job;
+static int job_frames, job_done;
+
+static uint64_t make_state (unsigned serial, int count, int next)
+    { return (uint64_t) serial << 32 | (uint64_t) count << 16 | next; }
+
+static int state_count (uint64_t state)
+    { return (state >> 16) & 0xffff; }
+static int state_next (uint64_t state)
+    { return state & 0xffff; }
+
+static bool work_left ()
+{
+    uint64_t state = __atomic_load_n (& job_state, __ATOMIC_SEQ_CST);
+    return state_next (state) < state_count (state);
+}
+
+/* runs one instance of the current job; returns false if none is left */
+static bool run_next ()
+{
+    uint64_t state = __atomic_load_n (& job_state, __ATOMIC_ACQUIRE);
+
+    while (state_next (state) < state_count (state))
+    {
+        /* these are valid as long as the job is not finished, which the
+         * compare-and-swap below makes sure of */
+        LoadedPlugin * loaded = __atomic_load_n (& job, __ATOMIC_RELAXED);
+        int frames = __atomic_load_n (& job_frames, __ATOMIC_RELAXED);
+
+        if (__atomic_compare_exchange_n (& job_state, & state, state + 1,
+         false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            loaded->plugin.desc->run (loaded->instances[state_next (state)], frames);
+            __atomic_fetch_add (& job_done, 1, __ATOMIC_RELEASE);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void * worker_thread (void *)
+{
+    int spins = 0;
+
+    while (! __atomic_load_n (& quit, __ATOMIC_ACQUIRE))
+    {
+        if (run_next ())
+        {
+            spins = 0;
+            continue;
+        }
+
+        if (++ spins < SPIN_COUNT)
+        {
+            sched_yield ();
+            continue;
+        }
+
+        pthread_mutex_lock (& mutex);
+        __atomic_fetch_add (& sleeping, 1, __ATOMIC_SEQ_CST);
+
+        if (! work_left () && ! quit)
+            pthread_cond_wait (& work_cond, & mutex);
+
+        __atomic_fetch_sub (& sleeping, 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock (& mutex);
+
+        spins = 0;
+    }
+
+    return nullptr;
+}
+
+void start_workers (int count)
+{
+    count = aud::clamp (count, 0, LADSPA_MAX_WORKERS);
+
+    if (count == worker_count)
+        return;
+
+    stop_workers ();
+
+    for (; worker_count < count; worker_count ++)
+    {
+        if (pthread_create (& workers[worker_count], nullptr, worker_thread, nullptr))
+        {
+            AUDERR ("Failed to start worker thread.\n");
+            break;
+        }
+    }
+}
+
+void stop_workers ()
+{
+    if (! worker_count)
+        return;
+
+    pthread_mutex_lock (& mutex);
+    __atomic_store_n (& quit, true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast (& work_cond);
+    pthread_mutex_unlock (& mutex);
+
+    for (int i = 0; i < worker_count; i ++)
+        pthread_join (workers[i], nullptr);
+
+    worker_count = 0;
+    quit = false;
+}
+
+void run_instances (LoadedPlugin & loaded, int frames)
+{
+    const LADSPA_Descriptor & desc = * loaded.plugin.desc;
+    int instances = loaded.instances.len ();
+
+    if (! worker_count || instances < 2)
+    {
+        for (int i = 0; i < instances; i ++)
+            desc.run (loaded.instances[i], frames);
+
+        return;
+    }
+
+    /* the last job is finished, so no other thread reads these now */
+    __atomic_store_n (& job, & loaded, __ATOMIC_RELAXED);
+    __atomic_store_n (& job_frames, frames, __ATOMIC_RELAXED);
+    __atomic_store_n (& job_done, 0, __ATOMIC_RELAXED);
+
+    unsigned serial = __atomic_load_n (& job_state, __ATOMIC_RELAXED) >> 32;
+    __atomic_store_n (& job_state, make_state (serial + 1, instances, 0), __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n (& sleeping, __ATOMIC_SEQ_CST) &&
+     pthread_mutex_trylock (& mutex) == 0)
+    {
+        pthread_cond_broadcast (& work_cond);
+        pthread_mutex_unlock (& mutex);
+    }
+
+    while (run_next ())
+        ;
+
+    while (__atomic_load_n (& job_done, __ATOMIC_ACQUIRE) < instances)
+        sched_yield ();
+}
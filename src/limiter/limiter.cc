@@ -0,0 +1,318 @@
+/*
+ * True Peak Limiter Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <math.h>
+
+#include <libaudcore/i18n.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+#include <libaudcore/ringbuf.h>
+#include <libaudcore/runtime.h>
+
+#include "../dsp-common/cached-setting.h"
+#include "../dsp-common/simd.h"
+#include "../dsp-common/sliding-max.h"
+#include "../dsp-common/true-peak.h"
+
+/* The peaks are found between the samples as well as at them, by upsampling 4
+ * times, so that the limited audio does not clip once it is converted to
+ * analog (or resampled).  The gain is computed once per block of BLOCK frames
+ * from the highest peak in the look-ahead window and ramped linearly in
+ * between.
+ *
+ * The required gain goes through a fast-attack, slow-release filter and is
+ * then averaged over the look-ahead time.  Since every gain that goes into the
+ * average was computed from a window containing the block being output (and
+ * the block after it, as the upsampled signal lags by a few samples), the
+ * average never exceeds the gain that block needs: the gain is brought down
+ * smoothly, over the look-ahead time, before each peak. */
+
+#define BLOCK 16
+
+#define CFGSECT "limiter"
+
+static const char * const limiter_defaults[] = {
+    "ceiling", "-1",
+    "lookahead_time", "5",
+    "release_time", "100",
+    nullptr
+};
+
+static void settings_changed ();
+
+static const PreferencesWidget limiter_widgets[] = {
+    WidgetLabel (N_("<b>Limiting</b>")),
+    WidgetSpin (N_("Ceiling:"),
+        WidgetFloat (CFGSECT, "ceiling", settings_changed),
+        {-12, 0, 0.1, N_("dBTP")}),
+    WidgetSpin (N_("Look-ahead time:"),
+        WidgetInt (CFGSECT, "lookahead_time"),
+        {1, 20, 1, N_("ms")}),
+    WidgetSpin (N_("Release time:"),
+        WidgetInt (CFGSECT, "release_time", settings_changed),
+        {10, 1000, 10, N_("ms")}),
+    WidgetLabel (N_("Changes to look-ahead take effect at the next song."))
+};
+
+static const PluginPreferences limiter_prefs = {{limiter_widgets}};
+
+class Limiter : public EffectPlugin
+{
+public:
+    static constexpr PluginInfo info = {
+        N_("True Peak Limiter"),
+        PACKAGE,
+        nullptr,
+        & limiter_prefs
+    };
+
+    /* last, so that it catches the overs of everything before it */
+    constexpr Limiter () : EffectPlugin (info, 9, true) {}
+
+    bool init ();
+    void cleanup ();
+
+    void start (int & channels, int & rate);
+    Index<float> & process (Index<float> & data);
+    bool flush (bool force);
+    Index<float> & finish (Index<float> & data, bool end_of_playlist);
+    int adjust_delay (int delay);
+};
+
+EXPORT Limiter aud_plugin_instance;
+
+static CachedSetting<float> ceiling (CFGSECT, "ceiling");
+static CachedSetting<int> release_time (CFGSECT, "release_time");
+
+/* The ring buffer holds the look-ahead (window_blocks blocks), the block after
+ * it and the block being filled.  The sliding maximum covers the same span. */
+static RingBuf<float> buffer;
+static Index<float> output, silence;
+static int current_channels, current_rate;
+static int window_blocks, block_fill;
+
+static SlidingMax peak_window;
+static Index<float> history, channel_peaks;
+static float sample_peak;
+
+static Index<float> gains;  /* the last window_blocks gains, circular */
+static int gain_pos;
+static float held_gain, current_gain;
+static float ceiling_gain, release_coef;
+
+static void settings_changed ()
+{
+    ceiling.update ();
+    release_time.update ();
+}
+
+/* Applies a gain ramp to the first <samples> samples of the ring buffer, which
+ * may wrap around its end. */
+static void ramp_buffer (int samples, float gain_a, float gain_b)
+{
+    float step = (gain_b - gain_a) / samples;
+    int linear = aud::min (samples, buffer.linear ());
+
+    simd_ramp (& buffer[0], linear, gain_a, step);
+
+    if (linear < samples)
+        simd_ramp (& buffer[linear], samples - linear, gain_a + step * linear, step);
+}
+
+static void end_block ()
+{
+    float peak = sample_peak;
+    for (float & p : channel_peaks)
+    {
+        peak = aud::max (peak, p);
+        p = 0;
+    }
+
+    sample_peak = 0;
+    peak_window.push (peak);
+
+    float max = peak_window.max ();
+    float target = (max > ceiling_gain) ? ceiling_gain / max : 1;
+
+    /* attack at once, release slowly */
+    held_gain = aud::min (target, held_gain + (target - held_gain) * release_coef);
+
+    gains[gain_pos] = held_gain;
+    gain_pos = (gain_pos + 1) % window_blocks;
+
+    float sum = 0;
+    for (float g : gains)
+        sum += g;
+
+    float new_gain = sum / window_blocks;
+
+    if (buffer.len () == buffer.size ())
+    {
+        int samples = BLOCK * current_channels;
+
+        if (current_gain != 1 || new_gain != 1)
+            ramp_buffer (samples, current_gain, new_gain);
+
+        buffer.move_out (output, -1, samples);
+    }
+
+    current_gain = new_gain;
+}
+
+static void limiter_process (const float * in, int samples)
+{
+    const float * end = in + samples;
+
+    while (in < end)
+    {
+        int frames = aud::min ((int) (end - in) / current_channels, BLOCK - block_fill);
+        int len = frames * current_channels;
+
+        buffer.copy_in (in, len);
+
+        simd_peak4 (in, current_channels, frames, true_peak_filter, TRUE_PEAK_TAPS,
+         history.begin (), channel_peaks.begin ());
+
+        for (int i = 0; i < len; i ++)
+            sample_peak = aud::max (sample_peak, fabsf (in[i]));
+
+        in += len;
+        block_fill += frames;
+
+        if (block_fill < BLOCK)
+            break;
+
+        block_fill = 0;
+        end_block ();
+    }
+}
+
+bool Limiter::init ()
+{
+    aud_config_set_defaults (CFGSECT, limiter_defaults);
+    settings_changed ();
+    return true;
+}
+
+void Limiter::cleanup ()
+{
+    buffer.destroy ();
+    output.clear ();
+    silence.clear ();
+    history.clear ();
+    channel_peaks.clear ();
+    gains.clear ();
+
+    current_channels = current_rate = 0;
+}
+
+/* Between songs of the same format, the audio held back is kept, so that
+ * nothing is lost at gapless song changes. */
+void Limiter::start (int & channels, int & rate)
+{
+    /* round the look-ahead up to whole blocks */
+    int frames = aud::rescale (aud_get_int (CFGSECT, "lookahead_time"), 1000, rate);
+    int blocks = aud::max (1, (frames + BLOCK - 1) / BLOCK);
+
+    if (channels == current_channels && rate == current_rate &&
+     blocks == window_blocks && buffer.size ())
+        return;
+
+    current_channels = channels;
+    current_rate = rate;
+    window_blocks = blocks;
+
+    buffer.alloc ((window_blocks + 2) * BLOCK * channels);
+    peak_window.resize (window_blocks + 2);
+
+    history.resize (0);
+    history.insert (0, (TRUE_PEAK_TAPS - 1) * channels);
+    channel_peaks.resize (0);
+    channel_peaks.insert (0, channels);
+    gains.resize (window_blocks);
+
+    silence.resize (0);
+    silence.insert (0, BLOCK * channels);
+
+    /* leave room for a second of output, so that it does not have to grow
+     * during playback */
+    int size = channels * rate;
+    if (output.len () < size)
+    {
+        output.insert (0, size);
+        output.resize (0);
+    }
+
+    flush (true);
+}
+
+Index<float> & Limiter::process (Index<float> & data)
+{
+    ceiling_gain = powf (10, ceiling.get () / 20);
+    release_coef = 1 - expf (-BLOCK / (release_time.get () * 0.001f * current_rate));
+
+    output.resize (0);
+    limiter_process (data.begin (), data.len ());
+
+    return output;
+}
+
+bool Limiter::flush (bool force)
+{
+    buffer.discard ();
+    block_fill = 0;
+
+    peak_window.reset ();
+    history.erase (0, -1);
+    channel_peaks.erase (0, -1);
+    sample_peak = 0;
+
+    for (float & g : gains)
+        g = 1;
+
+    gain_pos = 0;
+    held_gain = current_gain = 1;
+
+    return true;
+}
+
+/* At the end of the playlist, the audio held back is pushed out by silence,
+ * which lets the gain recover as it would if the audio went on. */
+Index<float> & Limiter::finish (Index<float> & data, bool end_of_playlist)
+{
+    process (data);
+
+    if (! end_of_playlist)
+        return output;
+
+    int end = output.len () + buffer.len ();
+
+    while (output.len () < end)
+        limiter_process (silence.begin (), (BLOCK - block_fill) * current_channels);
+
+    output.resize (end);
+    flush (true);
+
+    return output;
+}
+
+int Limiter::adjust_delay (int delay)
+{
+    return delay + aud::rescale<int64_t> (buffer.len () / current_channels, current_rate, 1000);
+}
@@ -17,14 +17,13 @@
  * the use of this software.
  */
 
-/* TODO: implement more surround converters */
-
-#include <stdlib.h>
-
 #include <libaudcore/i18n.h>
 #include <libaudcore/runtime.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
+#include <libaudcore/audstrings.h>
+
+#include "../dsp-common/simd.h"
 
 class ChannelMixer : public EffectPlugin
 {
@@ -53,159 +52,216 @@ public:
 
 EXPORT ChannelMixer aud_plugin_instance;
 
-typedef Index<float> & (* Converter) (Index<float> & data);
+/* Each conversion is described by a mixing matrix with one row per output
+ * channel and one coefficient per input channel.  The channels are in the
+ * usual order:
+ *
+ *   1: mono
+ *   2: front left, front right
+ *   4: front left, front right, rear left, rear right
+ *   5: front left, front right, center, rear left, rear right
+ *   6: front left, front right, center, LFE, rear left, rear right
+ *   8: front left, front right, center, LFE, rear left, rear right,
+ *      side left, side right
+ *
+ * Mixing up does not synthesize any surround content; the extra channels
+ * are left silent. */
 
-static Index<float> mixer_buf;
+static const float mono_to_stereo[] = {
+    1,
+    1
+};
 
-static Index<float> & mono_to_stereo (Index<float> & data)
-{
-    int frames = data.len ();
-    mixer_buf.resize (2 * frames);
+static const float stereo_to_mono[] = {
+    0.5, 0.5
+};
 
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
+static const float stereo_to_quadro[] = {
+    1, 0,
+    0, 1,
+    0, 0,
+    0, 0
+};
 
-    while (frames --)
-    {
-        float val = * get ++;
-        * set ++ = val;
-        * set ++ = val;
-    }
+static const float quadro_to_stereo[] = {
+    1, 0, 0.7, 0,
+    0, 1, 0, 0.7
+};
 
-    return mixer_buf;
-}
+/* 5 channels case. Quad + center channel */
+static const float quadro_5_to_stereo[] = {
+    1, 0, 0.5, 1, 0,
+    0, 1, 0.5, 0, 1
+};
 
-static Index<float> & stereo_to_mono (Index<float> & data)
-{
-    int frames = data.len () / 2;
-    mixer_buf.resize (frames);
+static const float stereo_to_surround_5p1[] = {
+    1, 0,
+    0, 1,
+    0, 0,
+    0, 0,
+    0, 0,
+    0, 0
+};
 
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
+static const float surround_5p1_to_stereo[] = {
+    1, 0, 0.5, 0.5, 0.5, 0,
+    0, 1, 0.5, 0.5, 0, 0.5
+};
 
-    while (frames --)
-    {
-        float val = * get ++;
-        val += * get ++;
-        * set ++ = val / 2;
-    }
+static const float stereo_to_surround_7p1[] = {
+    1, 0,
+    0, 1,
+    0, 0,
+    0, 0,
+    0, 0,
+    0, 0,
+    0, 0,
+    0, 0
+};
 
-    return mixer_buf;
-}
+static const float surround_7p1_to_stereo[] = {
+    1, 0, 0.5, 0.5, 0.5, 0, 0.5, 0,
+    0, 1, 0.5, 0.5, 0, 0.5, 0, 0.5
+};
 
-static Index<float> & quadro_to_stereo (Index<float> & data)
-{
-    int frames = data.len () / 4;
-    mixer_buf.resize (2 * frames);
+static const float surround_5p1_to_7p1[] = {
+    1, 0, 0, 0, 0, 0,
+    0, 1, 0, 0, 0, 0,
+    0, 0, 1, 0, 0, 0,
+    0, 0, 0, 1, 0, 0,
+    0, 0, 0, 0, 1, 0,
+    0, 0, 0, 0, 0, 1,
+    0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0
+};
 
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
+static const float surround_7p1_to_5p1[] = {
+    1, 0, 0, 0, 0, 0, 0, 0,
+    0, 1, 0, 0, 0, 0, 0, 0,
+    0, 0, 1, 0, 0, 0, 0, 0,
+    0, 0, 0, 1, 0, 0, 0, 0,
+    0, 0, 0, 0, 1, 0, 0.7, 0,
+    0, 0, 0, 0, 0, 1, 0, 0.7
+};
+
+static const struct {
+    int in, out;
+    const float * matrix;
+} builtin_matrices[] = {
+    {1, 2, mono_to_stereo},
+    {2, 1, stereo_to_mono},
+    {2, 4, stereo_to_quadro},
+    {4, 2, quadro_to_stereo},
+    {5, 2, quadro_5_to_stereo},
+    {2, 6, stereo_to_surround_5p1},
+    {6, 2, surround_5p1_to_stereo},
+    {2, 8, stereo_to_surround_7p1},
+    {8, 2, surround_7p1_to_stereo},
+    {6, 8, surround_5p1_to_7p1},
+    {8, 6, surround_7p1_to_5p1}
+};
 
-    while (frames --)
+static float matrix[AUD_MAX_CHANNELS * AUD_MAX_CHANNELS];
+static SimdMatrixFunc mix_func;
+static int input_channels, output_channels;
+static Index<float> mixer_buf;
+
+static const float * find_builtin (int in, int out)
+{
+    for (auto & builtin : builtin_matrices)
     {
-        float front_left  = * get ++;
-        float front_right = * get ++;
-        float back_left   = * get ++;
-        float back_right  = * get ++;
-        * set ++ = front_left + (back_left * 0.7);
-        * set ++ = front_right + (back_right * 0.7);
+        if (builtin.in == in && builtin.out == out)
+            return builtin.matrix;
     }
 
-    return mixer_buf;
+    return nullptr;
 }
 
-static Index<float> & surround_5p1_to_stereo (Index<float> & data)
+static bool load_builtin_matrix (int in, int out)
 {
-    int frames = data.len () / 6;
-    mixer_buf.resize (2 * frames);
+    const float * direct = find_builtin (in, out);
+    if (direct)
+    {
+        for (int i = 0; i < in * out; i ++)
+            matrix[i] = direct[i];
 
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
+        return true;
+    }
 
-    while (frames --)
+    /* other layouts are mixed through stereo */
+    const float * down = find_builtin (in, 2);
+    const float * up = find_builtin (2, out);
+    if (! down || ! up)
+        return false;
+
+    for (int o = 0; o < out; o ++)
     {
-        float front_left  = * get ++;
-        float front_right = * get ++;
-        float center = * get ++;
-        float lfe    = * get ++;
-        float rear_left   = * get ++;
-        float rear_right  = * get ++;
-        * set ++ = front_left + (center * 0.5) + (lfe * 0.5) + (rear_left * 0.5);
-        * set ++ = front_right + (center * 0.5) + (lfe * 0.5) + (rear_right * 0.5);
+        for (int i = 0; i < in; i ++)
+            matrix[o * in + i] = up[o * 2] * down[i] + up[o * 2 + 1] * down[in + i];
     }
 
-    return mixer_buf;
+    return true;
 }
 
-/* 5 channels case. Quad + center channel */
-static Index<float> & quadro_5_to_stereo (Index<float> & data)
+/* A matrix can be given in the config file as a comma-separated list of
+ * coefficients, row by row, e.g. "matrix-6-2" for 5.1 to stereo.  It takes
+ * precedence over the built-in one and may also remap channels (e.g. swap
+ * left and right with "matrix-2-2"). */
+static bool load_user_matrix (int in, int out)
 {
-    int frames = data.len () / 5;
-    mixer_buf.resize (2 * frames);
-
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
+    String str = aud_get_str ("mixer", str_printf ("matrix-%d-%d", in, out));
+    if (! str[0])
+        return false;
 
-    while (frames --)
+    double values[AUD_MAX_CHANNELS * AUD_MAX_CHANNELS];
+    if (! str_to_double_array (str, values, in * out))
     {
-        float front_left  = * get ++;
-        float front_right = * get ++;
-        float center = * get ++;
-        float rear_left   = * get ++;
-        float rear_right  = * get ++;
-        * set ++ = front_left + (center * 0.5) + rear_left;
-        * set ++ = front_right + (center * 0.5) + rear_right;
+        AUDERR ("Invalid mixing matrix for %d to %d channels (expected %d values).\n",
+         in, out, in * out);
+        return false;
     }
 
-    return mixer_buf;
-}
+    for (int i = 0; i < in * out; i ++)
+        matrix[i] = values[i];
 
-static Converter get_converter (int in, int out)
-{
-    if (in == 1 && out == 2)
-        return mono_to_stereo;
-    if (in == 2 && out == 1)
-        return stereo_to_mono;
-    if (in == 4 && out == 2)
-        return quadro_to_stereo;
-    if (in == 5 && out == 2)
-        return quadro_5_to_stereo;
-    if (in == 6 && out == 2)
-        return surround_5p1_to_stereo;
-
-    return nullptr;
+    return true;
 }
 
-static int input_channels, output_channels;
-
 void ChannelMixer::start (int & channels, int & rate)
 {
     input_channels = channels;
-    output_channels = aud_get_int ("mixer", "channels");
+    output_channels = aud::clamp (aud_get_int ("mixer", "channels"), 1, AUD_MAX_CHANNELS);
+    mix_func = nullptr;
 
-    if (input_channels == output_channels)
-        return;
-
-    if (! get_converter (input_channels, output_channels))
+    if (! load_user_matrix (input_channels, output_channels))
     {
-        AUDERR ("Converting %d to %d channels is not implemented.\n",
-         input_channels, output_channels);
-        return;
+        if (input_channels == output_channels)
+            return;
+
+        if (! load_builtin_matrix (input_channels, output_channels))
+        {
+            AUDERR ("Converting %d to %d channels is not implemented.\n",
+             input_channels, output_channels);
+            return;
+        }
     }
 
+    mix_func = simd_matrix_func (input_channels, output_channels);
     channels = output_channels;
 }
 
 Index<float> & ChannelMixer::process (Index<float> & data)
 {
-    if (input_channels == output_channels)
+    if (! mix_func)
         return data;
 
-    Converter converter = get_converter (input_channels, output_channels);
-    if (converter)
-        return converter (data);
+    int frames = data.len () / input_channels;
+    mixer_buf.resize (output_channels * frames);
+
+    mix_func (data.begin (), mixer_buf.begin (), frames, input_channels,
+     output_channels, matrix);
 
-    return data;
+    return mixer_buf;
 }
 
 const char * const ChannelMixer::defaults[] = {
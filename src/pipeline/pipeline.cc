@@ -0,0 +1,551 @@
+/*
+ * Effect Pipeline Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/i18n.h>
+#include <libaudcore/interface.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/plugins.h>
+#include <libaudcore/preferences.h>
+#include <libaudcore/runtime.h>
+
+/* Runs other effect plugins (those that take the most time, such as LADSPA
+ * effects or the convolver) on a thread of their own, so that they work on one
+ * block of audio while the playback thread decodes the next one.
+ *
+ * The audio is passed to the worker in blocks of BLOCK frames through a ring
+ * of slots.  Each of the three counters below is only ever written by one
+ * thread; the mutex is used only to put a thread to sleep when it has to wait
+ * for the other, never to guard the audio.  A block is returned once <depth>
+ * more blocks have been queued after it, so the delay is fixed. */
+
+#define BLOCK 1024
+#define MAX_DEPTH 8
+
+#define CFGSECT "pipeline"
+
+static const char * const pipeline_defaults[] = {
+    "effects", "",
+    "depth", "2",
+    nullptr
+};
+
+static const PreferencesWidget pipeline_widgets[] = {
+    WidgetLabel (N_("<b>Effects</b>")),
+    WidgetEntry (N_("Plugins:"), WidgetString (CFGSECT, "effects")),
+    WidgetLabel (N_("File names without extension, separated by commas\n"
+     "(for example, \"ladspa,speed-pitch\").  These effects must\n"
+     "not be enabled in the main effects list as well.")),
+    WidgetLabel (N_("<b>Buffering</b>")),
+    WidgetSpin (N_("Blocks in flight:"),
+        WidgetInt (CFGSECT, "depth"),
+        {1, MAX_DEPTH, 1}),
+    WidgetLabel (N_("Changes to the effects take effect when this plugin is\n"
+     "next enabled, changes to buffering at the next song."))
+};
+
+static const PluginPreferences pipeline_prefs = {{pipeline_widgets}};
+
+class Pipeline : public EffectPlugin
+{
+public:
+    static constexpr PluginInfo info = {
+        N_("Effect Pipeline"),
+        PACKAGE,
+        nullptr,
+        & pipeline_prefs
+    };
+
+    /* the effects run here may change the format */
+    constexpr Pipeline () : EffectPlugin (info, 4, false) {}
+
+    bool init ();
+    void cleanup ();
+
+    void start (int & channels, int & rate);
+    Index<float> & process (Index<float> & data);
+    bool flush (bool force);
+    Index<float> & finish (Index<float> & data, bool end_of_playlist);
+    int adjust_delay (int delay);
+};
+
+EXPORT Pipeline aud_plugin_instance;
+
+struct Slot {
+    Index<float> in, out;
+    int frames;
+    bool finish, end_of_playlist;
+};
+
+struct Hosted {
+    PluginHandle * plugin;
+    EffectPlugin * header;
+    int channels, rate;  /* as passed to start(), 0 if not started */
+    bool suspended;      /* being set up again; not to be run */
+};
+
+/* Held by the worker while it runs the effects, by the playback thread while
+ * it starts or flushes them, and by the main thread while it takes one back
+ * from the main effects list. */
+static pthread_mutex_t effects_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Index<Hosted> effects;
+
+static pthread_t worker_thread;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static bool worker_running, quit;
+
+static Slot slots[MAX_DEPTH + 1];
+static int num_slots, depth;
+
+/* slots queued and returned (playback thread), slots processed (worker) */
+static unsigned written, returned, processed;
+
+static Index<float> output;
+static int in_channels, in_rate;
+static int queued_frames;  /* read by adjust_delay() */
+static int effects_delay;  /* in milliseconds, as of the last block */
+
+/* Called in the main thread when a plugin run here is enabled or disabled in
+ * the main effects list.  It cannot run in both places, since the two would
+ * share its state, so it is disabled there again.  The core sets it up and
+ * then cleans it up in the same state the pipeline uses, so it is set aside
+ * while that happens (the worker waits until it is out of the plugin) and set
+ * up again for the pipeline afterwards.  The core cannot be called with the
+ * lock held, since it may wait for the playback thread, which may be waiting
+ * for the worker. */
+static bool enabled_changed (PluginHandle * plugin, void *)
+{
+    if (! aud_plugin_get_enabled (plugin))
+        return true;
+
+    Hosted * hosted = nullptr;
+
+    pthread_mutex_lock (& effects_mutex);
+
+    for (Hosted & h : effects)
+    {
+        if (h.plugin == plugin)
+        {
+            h.suspended = true;
+            hosted = & h;
+        }
+    }
+
+    pthread_mutex_unlock (& effects_mutex);
+
+    if (! hosted)
+        return true;
+
+    aud_ui_show_error (str_printf (_("%s is run by the Effect Pipeline and "
+     "cannot be enabled in the main effects list as well."),
+     aud_plugin_get_name (plugin)));
+
+    aud_plugin_enable (plugin, false);
+
+    /* the entry stays where it is, since only this thread adds or removes
+     * entries while the pipeline is running */
+    if (hosted->header->init ())
+    {
+        pthread_mutex_lock (& effects_mutex);
+
+        if (hosted->channels)
+        {
+            int channels = hosted->channels, rate = hosted->rate;
+            hosted->header->start (channels, rate);
+        }
+
+        hosted->suspended = false;
+        pthread_mutex_unlock (& effects_mutex);
+    }
+    else
+        AUDERR ("%s failed to initialize; no longer running it here.\n",
+         aud_plugin_get_name (plugin));
+
+    return true;
+}
+
+static void load_effects ()
+{
+    Index<String> names = str_list_to_index (aud_get_str (CFGSECT, "effects"), ", ");
+
+    for (const String & name : names)
+    {
+        PluginHandle * plugin = aud_plugin_lookup_basename (name);
+
+        if (! plugin || aud_plugin_get_type (plugin) != PluginType::Effect)
+        {
+            AUDERR ("No effect plugin named %s.\n", (const char *) name);
+            continue;
+        }
+
+        /* running the same plugin twice would mix up its state */
+        if (aud_plugin_get_enabled (plugin))
+        {
+            AUDERR ("%s is enabled in the main effects list; not running it "
+             "here.\n", aud_plugin_get_name (plugin));
+            continue;
+        }
+
+        auto header = (EffectPlugin *) aud_plugin_get_header (plugin);
+
+        if (! header || header == & aud_plugin_instance)
+            continue;
+
+        if (! header->init ())
+        {
+            AUDERR ("%s failed to initialize.\n", aud_plugin_get_name (plugin));
+            continue;
+        }
+
+        AUDINFO ("Running %s in the pipeline.\n", aud_plugin_get_name (plugin));
+        effects.append (Hosted {plugin, header, 0, 0, false});
+
+        aud_plugin_add_watch (plugin, enabled_changed, nullptr);
+    }
+
+    /* run them in the order the main effects list would */
+    effects.sort ([] (const Hosted & a, const Hosted & b)
+        { return a.header->order - b.header->order; });
+}
+
+/* called in the worker thread */
+static void run_slot (Slot & slot)
+{
+    Index<float> * data = & slot.in;
+
+    pthread_mutex_lock (& effects_mutex);
+
+    for (Hosted & h : effects)
+    {
+        if (h.suspended)
+            continue;
+
+        if (slot.finish)
+            data = & h.header->finish (* data, slot.end_of_playlist);
+        else
+            data = & h.header->process (* data);
+    }
+
+    slot.out.resize (0);
+    slot.out.insert (data->begin (), 0, data->len ());
+    slot.in.resize (0);
+
+    int delay = 0;
+    for (int i = effects.len () - 1; i >= 0; i --)
+    {
+        if (! effects[i].suspended)
+            delay = effects[i].header->adjust_delay (delay);
+    }
+
+    pthread_mutex_unlock (& effects_mutex);
+
+    __atomic_store_n (& effects_delay, delay, __ATOMIC_RELAXED);
+}
+
+static void * worker (void *)
+{
+    pthread_mutex_lock (& mutex);
+
+    while (true)
+    {
+        if (quit)
+            break;
+
+        if (processed == __atomic_load_n (& written, __ATOMIC_ACQUIRE))
+        {
+            pthread_cond_wait (& work_cond, & mutex);
+            continue;
+        }
+
+        pthread_mutex_unlock (& mutex);
+
+        run_slot (slots[processed % num_slots]);
+        __atomic_store_n (& processed, processed + 1, __ATOMIC_RELEASE);
+
+        pthread_mutex_lock (& mutex);
+        pthread_cond_signal (& done_cond);
+    }
+
+    pthread_mutex_unlock (& mutex);
+    return nullptr;
+}
+
+/* waits until the worker has processed the slot <count> */
+static void wait_processed (unsigned count)
+{
+    if (__atomic_load_n (& processed, __ATOMIC_ACQUIRE) - count < 0x80000000u)
+        return;
+
+    pthread_mutex_lock (& mutex);
+
+    while (__atomic_load_n (& processed, __ATOMIC_ACQUIRE) - count >= 0x80000000u)
+        pthread_cond_wait (& done_cond, & mutex);
+
+    pthread_mutex_unlock (& mutex);
+}
+
+/* returns the oldest slots until <keep> are left in flight */
+static void collect (unsigned keep)
+{
+    while (written - returned > keep)
+    {
+        wait_processed (returned + 1);
+
+        Slot & slot = slots[returned % num_slots];
+        output.insert (slot.out.begin (), -1, slot.out.len ());
+
+        __atomic_fetch_sub (& queued_frames, slot.frames, __ATOMIC_RELAXED);
+        slot.frames = 0;
+        returned ++;
+    }
+}
+
+static void publish (bool finish, bool end_of_playlist)
+{
+    Slot & slot = slots[written % num_slots];
+    slot.finish = finish;
+    slot.end_of_playlist = end_of_playlist;
+
+    __atomic_store_n (& written, written + 1, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock (& mutex);
+    pthread_cond_signal (& work_cond);
+    pthread_mutex_unlock (& mutex);
+
+    /* keep a slot free to be filled */
+    if (written - returned == (unsigned) num_slots)
+        collect (num_slots - 1);
+}
+
+static void push (const float * data, int samples)
+{
+    int block = BLOCK * in_channels;
+
+    while (samples > 0)
+    {
+        Slot & slot = slots[written % num_slots];
+        int len = aud::min (samples, block - slot.in.len ());
+
+        slot.in.insert (data, -1, len);
+        slot.frames += len / in_channels;
+        __atomic_fetch_add (& queued_frames, len / in_channels, __ATOMIC_RELAXED);
+
+        data += len;
+        samples -= len;
+
+        if (slot.in.len () == block)
+            publish (false, false);
+    }
+}
+
+/* throws away whatever is in flight, once the worker is done with it */
+static void discard ()
+{
+    wait_processed (written);
+
+    for (Slot & slot : slots)
+    {
+        slot.in.resize (0);
+        slot.frames = 0;
+    }
+
+    returned = written;
+    __atomic_store_n (& queued_frames, 0, __ATOMIC_RELAXED);
+}
+
+bool Pipeline::init ()
+{
+    aud_config_set_defaults (CFGSECT, pipeline_defaults);
+
+    load_effects ();
+
+    if (! effects.len ())
+        return true;
+
+    quit = false;
+    if (pthread_create (& worker_thread, nullptr, worker, nullptr))
+    {
+        AUDERR ("Failed to create worker thread.\n");
+
+        for (Hosted & h : effects)
+        {
+            aud_plugin_remove_watch (h.plugin, enabled_changed, nullptr);
+            h.header->cleanup ();
+        }
+
+        effects.clear ();
+        return false;
+    }
+
+    worker_running = true;
+    return true;
+}
+
+void Pipeline::cleanup ()
+{
+    if (worker_running)
+    {
+        pthread_mutex_lock (& mutex);
+        quit = true;
+        pthread_cond_signal (& work_cond);
+        pthread_mutex_unlock (& mutex);
+
+        pthread_join (worker_thread, nullptr);
+        worker_running = false;
+    }
+
+    for (Hosted & h : effects)
+    {
+        aud_plugin_remove_watch (h.plugin, enabled_changed, nullptr);
+
+        /* one that failed to be set up again is already cleaned up */
+        if (! h.suspended)
+            h.header->cleanup ();
+    }
+
+    effects.clear ();
+
+    for (Slot & slot : slots)
+    {
+        slot.in.clear ();
+        slot.out.clear ();
+    }
+
+    output.clear ();
+}
+
+void Pipeline::start (int & channels, int & rate)
+{
+    if (! worker_running)
+        return;
+
+    /* the worker is idle from here on */
+    if (num_slots)
+        discard ();
+
+    depth = aud::clamp (aud_get_int (CFGSECT, "depth"), 1, MAX_DEPTH);
+    num_slots = depth + 1;
+
+    in_channels = channels;
+    in_rate = rate;
+
+    pthread_mutex_lock (& effects_mutex);
+
+    for (Hosted & h : effects)
+    {
+        h.channels = channels;
+        h.rate = rate;
+
+        if (! h.suspended)
+            h.header->start (channels, rate);
+    }
+
+    pthread_mutex_unlock (& effects_mutex);
+
+    __atomic_store_n (& effects_delay, 0, __ATOMIC_RELAXED);
+
+    for (int i = 0; i < num_slots; i ++)
+    {
+        Index<float> & in = slots[i].in;
+        if (in.len () < BLOCK * in_channels)
+        {
+            in.insert (0, BLOCK * in_channels);
+            in.resize (0);
+        }
+    }
+
+    /* leave room for a second of output, so that it does not have to grow
+     * during playback */
+    int size = channels * rate;
+    if (output.len () < size)
+    {
+        output.insert (0, size);
+        output.resize (0);
+    }
+}
+
+Index<float> & Pipeline::process (Index<float> & data)
+{
+    if (! worker_running)
+        return data;
+
+    output.resize (0);
+
+    push (data.begin (), data.len ());
+    collect (depth);
+
+    return output;
+}
+
+bool Pipeline::flush (bool force)
+{
+    if (! worker_running)
+        return true;
+
+    if (num_slots)
+        discard ();
+
+    bool flushed = true;
+
+    pthread_mutex_lock (& effects_mutex);
+
+    for (Hosted & h : effects)
+    {
+        if (! h.suspended && ! (flushed = h.header->flush (force)))
+            break;
+    }
+
+    pthread_mutex_unlock (& effects_mutex);
+    return flushed;
+}
+
+/* The effects are finished at the same point in the audio as they would be in
+ * the main effects list, by a slot cut short.  Everything in flight is returned
+ * then, so that the next song starts with the pipeline empty. */
+Index<float> & Pipeline::finish (Index<float> & data, bool end_of_playlist)
+{
+    if (! worker_running)
+        return data;
+
+    output.resize (0);
+
+    push (data.begin (), data.len ());
+    publish (true, end_of_playlist);
+    collect (0);
+
+    return output;
+}
+
+/* The delay of the effects themselves is taken as of the last block processed,
+ * since they cannot be asked while the worker is running them. */
+int Pipeline::adjust_delay (int delay)
+{
+    if (! worker_running)
+        return delay;
+
+    int frames = __atomic_load_n (& queued_frames, __ATOMIC_RELAXED);
+
+    return delay + __atomic_load_n (& effects_delay, __ATOMIC_RELAXED) +
+     aud::rescale<int64_t> (frames, in_rate, 1000);
+}
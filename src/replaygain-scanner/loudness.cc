@@ -0,0 +1 @@
+#include "../dsp-common/loudness.cc"
@@ -0,0 +1,491 @@
+/*
+ * ReplayGain Scanner Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+/* Measures the loudness of the selected playlist entries as specified by EBU
+ * R 128 and writes ReplayGain 2.0 track and album gains into their tags.  Files
+ * in the same folder with the same album tag are taken to be one album.
+ *
+ * The input plugins can only decode inside the playback engine, one file at a
+ * time, so the files are decoded here with libsndfile instead (through VFS, so
+ * that any transport works).  Each worker thread takes the next file from the
+ * list until none are left; the measurement itself is cheap enough that the
+ * scan scales with the number of cores as long as the disk keeps up. */
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sndfile.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/i18n.h>
+#include <libaudcore/interface.h>
+#include <libaudcore/mainloop.h>
+#include <libaudcore/multihash.h>
+#include <libaudcore/playlist.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+#include <libaudcore/probe.h>
+#include <libaudcore/runtime.h>
+
+#include "../dsp-common/loudness.h"
+
+#define MAX_THREADS 64
+#define CHUNK_FRAMES 4096
+
+#define REFERENCE_LOUDNESS -18.0  /* LUFS, as in ReplayGain 2.0 */
+#define GAIN_UNIT 1000000         /* for tuples that have no divisor yet */
+
+class ReplayGainScanner : public GeneralPlugin
+{
+public:
+    static const char * const defaults[];
+    static const PreferencesWidget widgets[];
+    static const PluginPreferences prefs;
+
+    static constexpr PluginInfo info = {
+        N_("ReplayGain Scanner"),
+        PACKAGE,
+        nullptr,
+        & prefs
+    };
+
+    constexpr ReplayGainScanner () : GeneralPlugin (info, false) {}
+
+    bool init ();
+    void cleanup ();
+};
+
+EXPORT ReplayGainScanner aud_plugin_instance;
+
+static constexpr AudMenuID menus[] = {
+    AudMenuID::Main,
+    AudMenuID::Playlist
+};
+
+struct Track
+{
+    String filename;
+    PluginHandle * decoder = nullptr;
+    Tuple tuple;
+
+    bool measured = false;
+    double loudness = 0;
+    float peak = 0;
+    Index<double> blocks;
+    int album = -1;
+};
+
+struct Album
+{
+    Index<double> blocks;
+    float peak = 0;
+};
+
+/* written by the main thread only while no scan is running */
+static Index<Track> s_tracks;
+static Index<Album> s_albums;
+static int s_threads;
+
+static pthread_t s_scan_thread;
+static bool s_running;
+static bool s_cancel;
+static int s_next;
+static QueuedFunc s_done;
+
+/* Virtual file access wrappers for libsndfile, as in the sndfile plugin */
+static sf_count_t sf_get_filelen (void * user_data)
+{
+    int64_t size = ((VFSFile *) user_data)->fsize ();
+    return (size < 0) ? SF_COUNT_MAX : size;
+}
+
+static sf_count_t sf_vseek (sf_count_t offset, int whence, void * user_data)
+{
+    if (((VFSFile *) user_data)->fseek (offset, to_vfs_seek_type (whence)) != 0)
+        return -1;
+
+    return ((VFSFile *) user_data)->ftell ();
+}
+
+static sf_count_t sf_vseek_dummy (sf_count_t offset, int whence, void * user_data)
+{
+    return -1;
+}
+
+static sf_count_t sf_vread (void * ptr, sf_count_t count, void * user_data)
+{
+    return ((VFSFile *) user_data)->fread (ptr, 1, count);
+}
+
+static sf_count_t sf_vwrite_dummy (const void * ptr, sf_count_t count, void * user_data)
+{
+    return 0;
+}
+
+static sf_count_t sf_tell (void * user_data)
+{
+    return ((VFSFile *) user_data)->ftell ();
+}
+
+static SF_VIRTUAL_IO sf_virtual_io = {
+    sf_get_filelen,
+    sf_vseek,
+    sf_vread,
+    sf_vwrite_dummy,
+    sf_tell
+};
+
+static SF_VIRTUAL_IO sf_virtual_io_stream = {
+    sf_get_filelen,
+    sf_vseek_dummy,
+    sf_vread,
+    sf_vwrite_dummy,
+    sf_tell
+};
+
+static bool cancelled ()
+    { return __atomic_load_n (& s_cancel, __ATOMIC_RELAXED); }
+
+static bool read_tag (Track & track)
+{
+    VFSFile file;
+    track.decoder = aud_file_find_decoder (track.filename, false, file);
+
+    if (! track.decoder || ! aud_file_read_tag (track.filename, track.decoder, file, track.tuple))
+        return false;
+
+    if (! aud_file_can_write_tuple (track.filename, track.decoder))
+    {
+        AUDWARN ("Cannot write tags to %s.\n", (const char *) track.filename);
+        return false;
+    }
+
+    return true;
+}
+
+static bool measure (Track & track)
+{
+    VFSFile file (track.filename, "r");
+    if (! file)
+    {
+        AUDERR ("%s: %s\n", (const char *) track.filename, file.error ());
+        return false;
+    }
+
+    bool stream = (file.fsize () < 0);
+    SF_INFO sfinfo {};
+
+    SNDFILE * sndfile = sf_open_virtual (stream ? & sf_virtual_io_stream :
+     & sf_virtual_io, SFM_READ, & sfinfo, & file);
+
+    if (! sndfile)
+    {
+        AUDERR ("Cannot decode %s: %s\n", (const char *) track.filename, sf_strerror (nullptr));
+        return false;
+    }
+
+    LoudnessMeter meter;
+    meter.start (sfinfo.channels, sfinfo.samplerate);
+
+    Index<float> buffer;
+    buffer.insert (0, sfinfo.channels * CHUNK_FRAMES);
+
+    sf_count_t frames;
+    while (! cancelled () && (frames = sf_readf_float (sndfile, buffer.begin (), CHUNK_FRAMES)) > 0)
+        meter.process (buffer.begin (), frames);
+
+    sf_close (sndfile);
+
+    if (cancelled ())
+        return false;
+
+    track.loudness = meter.integrated ();
+    track.peak = meter.true_peak ();
+    auto & blocks = meter.blocks ();
+    track.blocks.insert (blocks.begin (), 0, blocks.len ());
+
+    AUDDBG ("%s: %.2f LUFS, %.2f LU, peak %.6f\n", (const char *) track.filename,
+     track.loudness, meter.range (), track.peak);
+
+    /* digital silence has no loudness to correct */
+    return track.loudness > -HUGE_VAL;
+}
+
+static void * worker_thread (void *)
+{
+    int count = s_tracks.len ();
+    int i;
+
+    while (! cancelled () && (i = __atomic_fetch_add (& s_next, 1, __ATOMIC_RELAXED)) < count)
+    {
+        Track & track = s_tracks[i];
+        track.measured = read_tag (track) && measure (track);
+    }
+
+    return nullptr;
+}
+
+/* the scanning thread runs as one of the workers itself */
+static void run_workers ()
+{
+    pthread_t workers[MAX_THREADS];
+    int count = aud::min (s_threads, s_tracks.len ());
+    int started = 1;
+
+    s_next = 0;
+
+    for (; started < count; started ++)
+    {
+        if (pthread_create (& workers[started], nullptr, worker_thread, nullptr))
+        {
+            AUDERR ("Failed to start worker thread.\n");
+            break;
+        }
+    }
+
+    worker_thread (nullptr);
+
+    for (int i = 1; i < started; i ++)
+        pthread_join (workers[i], nullptr);
+}
+
+static void group_albums ()
+{
+    SimpleHash<String, int> albums;
+
+    for (Track & track : s_tracks)
+    {
+        if (! track.measured)
+            continue;
+
+        String album = track.tuple.get_str (Tuple::Album);
+        if (! album)
+            continue;
+
+        const char * slash = strrchr (track.filename, '/');
+        int dir_len = slash ? slash - track.filename : 0;
+        String key (str_concat ({str_copy (track.filename, dir_len), "\n", album}));
+
+        int * index = albums.lookup (key);
+        if (! index)
+        {
+            index = albums.add (key, s_albums.len ());
+            s_albums.append ();
+        }
+
+        Album & a = s_albums[* index];
+        a.blocks.insert (track.blocks.begin (), -1, track.blocks.len ());
+        a.peak = aud::max (a.peak, track.peak);
+
+        track.album = * index;
+    }
+}
+
+static void set_gain (Tuple & tuple, Tuple::Field field, Tuple::Field unit_field, double value)
+{
+    int unit = tuple.get_int (unit_field);
+
+    if (unit <= 0)
+    {
+        unit = GAIN_UNIT;
+        tuple.set_int (unit_field, unit);
+    }
+
+    tuple.set_int (field, lrint (value * unit));
+}
+
+/* Tags are written one file at a time; the tag writers of some plugins (and
+ * the playlist rescan that follows) are not made to run concurrently. */
+static int write_tags ()
+{
+    int written = 0;
+
+    for (Track & track : s_tracks)
+    {
+        if (cancelled ())
+            break;
+        if (! track.measured)
+            continue;
+
+        Tuple & tuple = track.tuple;
+
+        set_gain (tuple, Tuple::TrackGain, Tuple::GainDivisor, REFERENCE_LOUDNESS - track.loudness);
+        set_gain (tuple, Tuple::TrackPeak, Tuple::PeakDivisor, track.peak);
+
+        if (track.album >= 0)
+        {
+            Album & album = s_albums[track.album];
+            double loudness = LoudnessMeter::gated_loudness (album.blocks);
+
+            set_gain (tuple, Tuple::AlbumGain, Tuple::GainDivisor, REFERENCE_LOUDNESS - loudness);
+            set_gain (tuple, Tuple::AlbumPeak, Tuple::PeakDivisor, album.peak);
+        }
+
+        if (aud_file_write_tuple (track.filename, track.decoder, tuple))
+            written ++;
+        else
+            AUDERR ("Failed to write tags to %s.\n", (const char *) track.filename);
+    }
+
+    return written;
+}
+
+static void scan_done (void * written)
+{
+    pthread_join (s_scan_thread, nullptr);
+    s_running = false;
+
+    int total = s_tracks.len ();
+    int count = aud::from_ptr<int> (written);
+
+    StringBuf message = str_printf (dngettext (PACKAGE,
+     "ReplayGain scan finished: %d of %d file tagged.",
+     "ReplayGain scan finished: %d of %d files tagged.", total), count, total);
+
+    if (count < total)
+    {
+        message.insert (-1, "\n\n");
+        message.insert (-1, _("The following files could not be decoded or tagged:"));
+
+        int shown = 0;
+        for (const Track & track : s_tracks)
+        {
+            if (track.measured)
+                continue;
+
+            if (shown ++ == 10)
+            {
+                message.insert (-1, "\n...");
+                break;
+            }
+
+            message.insert (-1, "\n");
+            message.insert (-1, uri_to_display (track.filename));
+        }
+    }
+
+    AUDINFO ("%s\n", (const char *) message);
+    aud_ui_show_error (message);
+
+    s_tracks.clear ();
+    s_albums.clear ();
+}
+
+static void * scan_thread (void *)
+{
+    run_workers ();
+    group_albums ();
+
+    int written = write_tags ();
+
+    s_done.queue (scan_done, aud::to_ptr (written));
+    return nullptr;
+}
+
+static int thread_count ()
+{
+    int threads = aud_get_int ("replaygain_scanner", "threads");
+
+#ifdef _SC_NPROCESSORS_ONLN
+    if (threads <= 0)
+        threads = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+
+    return aud::clamp (threads, 1, MAX_THREADS);
+}
+
+static void start_scan ()
+{
+    if (s_running)
+    {
+        aud_ui_show_error (_("A ReplayGain scan is already running."));
+        return;
+    }
+
+    auto playlist = Playlist::active_playlist ();
+    int entries = playlist.n_entries ();
+
+    for (int i = 0; i < entries; i ++)
+    {
+        if (playlist.entry_selected (i))
+            s_tracks.append ().filename = playlist.entry_filename (i);
+    }
+
+    if (! s_tracks.len ())
+    {
+        aud_ui_show_error (_("No files are selected."));
+        return;
+    }
+
+    s_threads = thread_count ();
+    s_cancel = false;
+
+    AUDINFO ("Scanning %d files with %d threads.\n", s_tracks.len (), s_threads);
+
+    if (pthread_create (& s_scan_thread, nullptr, scan_thread, nullptr))
+    {
+        AUDERR ("Failed to start scanning thread.\n");
+        s_tracks.clear ();
+        return;
+    }
+
+    s_running = true;
+}
+
+const char * const ReplayGainScanner::defaults[] = {
+ "threads", "0",
+ nullptr};
+
+bool ReplayGainScanner::init ()
+{
+    aud_config_set_defaults ("replaygain_scanner", defaults);
+
+    for (AudMenuID menu : menus)
+        aud_plugin_menu_add (menu, start_scan, _("Scan ReplayGain"), "audio-volume-high");
+
+    return true;
+}
+
+void ReplayGainScanner::cleanup ()
+{
+    if (s_running)
+    {
+        __atomic_store_n (& s_cancel, true, __ATOMIC_RELAXED);
+        pthread_join (s_scan_thread, nullptr);
+        s_done.stop ();
+        s_running = false;
+
+        s_tracks.clear ();
+        s_albums.clear ();
+    }
+
+    for (AudMenuID menu : menus)
+        aud_plugin_menu_remove (menu, start_scan);
+}
+
+const PreferencesWidget ReplayGainScanner::widgets[] = {
+    WidgetLabel (N_("<b>Scanning</b>")),
+    WidgetSpin (N_("Threads:"),
+        WidgetInt ("replaygain_scanner", "threads"),
+        {0, MAX_THREADS, 1, N_("(0 for one per core)")})
+};
+
+const PluginPreferences ReplayGainScanner::prefs = {{widgets}};
@@ -0,0 +1,221 @@
+/*
+ * Polyphase FIR Resampler for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "polyphase.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "../dsp-common/simd.h"
+
+/* Filter taps per phase when upsampling; downsampling scales this by the
+ * ratio so that the transition band stays the same relative to the output
+ * rate.  With a Kaiser window of beta 10, this gives a stopband attenuation of
+ * about 100 dB from the lower Nyquist frequency and a passband to about 94% of
+ * it. */
+#define TAPS 256
+#define KAISER_BETA 10.0
+#define CUTOFF 0.485   /* fraction of the lower sample rate */
+
+/* largest supported upsampling factor (bounds the size of the filter bank) */
+#define MAX_PHASES 640
+
+static int gcd (int a, int b)
+{
+    while (b)
+    {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+static double bessel_i0 (double x)
+{
+    double sum = 1, term = 1;
+
+    for (int k = 1; k < 64 && term > sum * 1e-14; k ++)
+    {
+        double f = x / (2 * k);
+        term *= f * f;
+        sum += term;
+    }
+
+    return sum;
+}
+
+bool Polyphase::supported (int in_rate, int out_rate)
+{
+    return out_rate / gcd (in_rate, out_rate) <= MAX_PHASES;
+}
+
+bool Polyphase::matches (int in_rate, int out_rate, int channels) const
+{
+    int g = gcd (in_rate, out_rate);
+    return out_rate / g == m_up && in_rate / g == m_down && channels == m_channels;
+}
+
+void Polyphase::setup (int in_rate, int out_rate, int channels)
+{
+    int g = gcd (in_rate, out_rate);
+    int up = out_rate / g;
+    int down = in_rate / g;
+
+    if (up != m_up || down != m_down)
+    {
+        m_up = up;
+        m_down = down;
+
+        /* round up to a multiple of 16 for the vectorized dot product */
+        double scale = aud::max (1.0, (double) down / up);
+        m_taps = ((int) ceil (TAPS * scale) + 15) & ~15;
+
+        int length = up * m_taps;
+        double center = (length - 1) / 2.0;
+        double cutoff = CUTOFF * aud::min (1.0, (double) up / down) / up;
+        double window_norm = bessel_i0 (KAISER_BETA);
+
+        m_bank.resize (length);
+        m_delay = (int) center;
+
+        for (int phase = 0; phase < up; phase ++)
+        {
+            for (int k = 0; k < m_taps; k ++)
+            {
+                double t = phase + k * up - center;
+                double r = t / (center + 1);
+                double window = bessel_i0 (KAISER_BETA * sqrt (aud::max (0.0, 1 - r * r))) / window_norm;
+                double sinc = (t == 0) ? 2 * cutoff : sin (2 * M_PI * cutoff * t) / (M_PI * t);
+
+                /* the gain of "up" makes up for the zeros stuffed between the
+                 * input samples */
+                m_bank[phase * m_taps + (m_taps - 1 - k)] = up * sinc * window;
+            }
+        }
+
+        m_zeros.resize (0);
+    }
+
+    if (channels != m_channels)
+    {
+        m_channels = channels;
+        m_zeros.resize (0);
+    }
+
+    reset ();
+}
+
+void Polyphase::reset ()
+{
+    /* start with a full filter length of silence */
+    m_fill = m_taps - 1;
+    m_stride = aud::max (m_stride, m_fill);
+    m_rows.resize (m_stride * m_channels);
+
+    for (int c = 0; c < m_channels; c ++)
+        memset (& m_rows[c * m_stride], 0, sizeof (float) * m_fill);
+
+    /* line the center of the filter up with the first input sample */
+    m_pos = (int64_t) (m_taps - 1) * m_up + m_delay;
+}
+
+void Polyphase::clear ()
+{
+    m_up = m_down = m_channels = m_taps = m_delay = 0;
+    m_stride = m_fill = 0;
+
+    m_bank.clear ();
+    m_rows.clear ();
+    m_zeros.clear ();
+}
+
+void Polyphase::process (const float * in, int frames, Index<float> & out)
+{
+    if (m_fill + frames > m_stride)
+    {
+        int new_stride = m_fill + frames;
+        Index<float> rows;
+        rows.resize (new_stride * m_channels);
+
+        for (int c = 0; c < m_channels; c ++)
+            memcpy (& rows[c * new_stride], & m_rows[c * m_stride], sizeof (float) * m_fill);
+
+        m_rows = std::move (rows);
+        m_stride = new_stride;
+    }
+
+    for (int c = 0; c < m_channels; c ++)
+    {
+        float * row = & m_rows[c * m_stride + m_fill];
+        for (int f = 0; f < frames; f ++)
+            row[f] = in[f * m_channels + c];
+    }
+
+    m_fill += frames;
+
+    int64_t end = (int64_t) m_fill * m_up;
+    int count = (m_pos < end) ? (int) ((end - m_pos - 1) / m_down + 1) : 0;
+
+    float * dest = out.insert (-1, count * m_channels);
+
+    for (int i = 0; i < count; i ++)
+    {
+        int base = m_pos / m_up;
+        int phase = m_pos % m_up;
+        const float * coefs = & m_bank[phase * m_taps];
+        int start = base - (m_taps - 1);
+
+        for (int c = 0; c < m_channels; c ++)
+            * dest ++ = simd_dot (coefs, & m_rows[c * m_stride + start], m_taps);
+
+        m_pos += m_down;
+    }
+
+    /* keep one filter length of history before the next output */
+    int shift = aud::clamp<int64_t> (m_pos / m_up - (m_taps - 1), 0, m_fill);
+
+    if (shift)
+    {
+        for (int c = 0; c < m_channels; c ++)
+        {
+            float * row = & m_rows[c * m_stride];
+            memmove (row, row + shift, sizeof (float) * (m_fill - shift));
+        }
+
+        m_fill -= shift;
+        m_pos -= (int64_t) shift * m_up;
+    }
+}
+
+void Polyphase::drain (Index<float> & out)
+{
+    /* half a filter length of silence brings the last input sample past the
+     * center of the filter */
+    int frames = m_delay / m_up + 1;
+
+    if (m_zeros.len () != frames * m_channels)
+    {
+        m_zeros.resize (frames * m_channels);
+        m_zeros.erase (0, -1);
+    }
+
+    process (m_zeros.begin (), frames, out);
+}
@@ -0,0 +1,63 @@
+/*
+ * Polyphase FIR Resampler for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef AUD_RESAMPLE_POLYPHASE_H
+#define AUD_RESAMPLE_POLYPHASE_H
+
+#include <stdint.h>
+#include <libaudcore/index.h>
+
+/* Fixed-ratio resampler for rates related by a small rational factor up/down,
+ * such as 44.1 <-> 48 kHz (160/147) or the power-of-two multiples.  The input
+ * is conceptually upsampled by "up", lowpass filtered, and decimated by "down";
+ * only the taps that meet nonzero input samples are ever computed, so each
+ * output sample is one dot product against one phase of a precomputed filter
+ * bank. */
+
+class Polyphase
+{
+public:
+    static bool supported (int in_rate, int out_rate);
+
+    bool matches (int in_rate, int out_rate, int channels) const;
+
+    /* builds the filter bank (if the ratio changed) and resets the history */
+    void setup (int in_rate, int out_rate, int channels);
+    void reset ();
+    void clear ();
+
+    /* appends the resampled audio to <out> */
+    void process (const float * in, int frames, Index<float> & out);
+
+    /* pushes the audio still held in the filter out to <out> */
+    void drain (Index<float> & out);
+
+private:
+    int m_up = 0, m_down = 0, m_channels = 0;
+    int m_taps = 0;          /* per phase */
+    int m_delay = 0;         /* filter delay, in upsampled samples */
+
+    Index<float> m_bank;     /* m_up phases of m_taps, time-reversed */
+    Index<float> m_rows;     /* deinterleaved input history, one row per channel */
+    Index<float> m_zeros;
+    int m_stride = 0, m_fill = 0;
+    int64_t m_pos = 0;       /* next output, in upsampled samples into the rows */
+};
+
+#endif
@@ -17,6 +17,7 @@
  * the use of this software.
  */
 
+#include <stdint.h>
 #include <samplerate.h>
 
 #include <libaudcore/i18n.h>
@@ -25,12 +26,20 @@
 #include <libaudcore/preferences.h>
 #include <libaudcore/audstrings.h>
 
+#include "polyphase.h"
+
 #define MIN_RATE 8000
 #define MAX_RATE 192000
 #define RATE_STEP 50
 
 #define RESAMPLE_ERROR(e) AUDERR ("%s\n", src_strerror (e))
 
+/* number of converter states kept around for reuse */
+#define CACHE_SIZE 4
+
+/* not a libsamplerate converter type: use the built-in polyphase engine */
+#define METHOD_POLYPHASE 100
+
 class Resampler : public EffectPlugin
 {
 public:
@@ -58,7 +67,7 @@ public:
     Index<float> & process (Index<float> & data)
         { return resample (data, false); }
     Index<float> & finish (Index<float> & data, bool end_of_playlist)
-        { return resample (data, true); }
+        { return resample (data, end_of_playlist); }
 
 private:
     Index<float> & resample (Index<float> & data, bool finish);
@@ -82,36 +91,168 @@ const char * const Resampler::defaults[] = {
  "192000", "48000",
  nullptr};
 
+/* Converter states are cached by format.  When consecutive songs share a
+ * format, the next song picks up the same state without resetting it, so the
+ * filter history carries over and the transition is gapless.  Otherwise, what
+ * is left of the last song in the converter is drained in start() and output
+ * ahead of the next song.  A state is only reset when it is reused after a
+ * different one has been active. */
+
+struct CachedState {
+    SRC_STATE * state;
+    int method, channels;
+    double ratio;
+    int64_t last_used;
+};
+
+static CachedState cache[CACHE_SIZE];
+static int64_t cache_clock;
+static int cache_hits, cache_misses;
+
 static SRC_STATE * state;
-static int stored_channels;
+static Polyphase polyphase;
+static bool use_polyphase;
+static int stored_channels, stored_rate;  /* output format */
 static double ratio;
 static Index<float> buffer;
+static Index<float> held;  /* the end of the last song, drained at a switch */
 
-bool Resampler::init ()
+static SRC_STATE * get_state (int method, int channels, double new_ratio, SRC_STATE * previous)
 {
-    aud_config_set_defaults ("resample", defaults);
-    return true;
+    CachedState * slot = & cache[0];
+
+    for (CachedState & entry : cache)
+    {
+        if (entry.state && entry.method == method &&
+         entry.channels == channels && entry.ratio == new_ratio)
+        {
+            cache_hits ++;
+            AUDDBG ("State cache hit (%d hits, %d misses)\n", cache_hits, cache_misses);
+
+            int error;
+            if (entry.state != previous && (error = src_reset (entry.state)))
+                RESAMPLE_ERROR (error);
+
+            entry.last_used = ++ cache_clock;
+            return entry.state;
+        }
+
+        /* remember an empty or the least recently used slot */
+        if (slot->state && (! entry.state || entry.last_used < slot->last_used))
+            slot = & entry;
+    }
+
+    cache_misses ++;
+    AUDDBG ("State cache miss (%d hits, %d misses)\n", cache_hits, cache_misses);
+
+    if (slot->state)
+        src_delete (slot->state);
+
+    int error;
+    if ((slot->state = src_new (method, channels, & error)) == nullptr)
+    {
+        RESAMPLE_ERROR (error);
+        return nullptr;
+    }
+
+    slot->method = method;
+    slot->channels = channels;
+    slot->ratio = new_ratio;
+    slot->last_used = ++ cache_clock;
+
+    return slot->state;
 }
 
-void Resampler::cleanup ()
+static bool state_matches (SRC_STATE * s, int method, int channels, double new_ratio)
 {
-    if (state)
+    for (const CachedState & entry : cache)
     {
-        src_delete (state);
-        state = nullptr;
+        if (entry.state == s)
+            return (entry.method == method && entry.channels == channels &&
+             entry.ratio == new_ratio);
     }
 
-    buffer.clear ();
+    return false;
 }
 
-void Resampler::start (int & channels, int & rate)
+/* Pushes what is left of the last song out of the active converter into
+ * <held>, if the next song is output in the same format; otherwise it would
+ * have to be played at the wrong rate, and is dropped. */
+static void drain_state (int next_rate, int next_channels)
+{
+    bool keep = (stored_rate == next_rate && stored_channels == next_channels);
+
+    if (use_polyphase)
+    {
+        if (keep)
+            polyphase.drain (held);
+
+        polyphase.reset ();
+    }
+    else if (state)
+    {
+        static float no_input;
+        int error = 0;
+
+        while (keep)
+        {
+            int offset = held.len ();
+            held.insert (-1, 1024 * stored_channels);
+
+            SRC_DATA d = SRC_DATA ();
+
+            d.data_in = & no_input;
+            d.input_frames = 0;
+            d.data_out = & held[offset];
+            d.output_frames = 1024;
+            d.src_ratio = ratio;
+            d.end_of_input = true;
+
+            if ((error = src_process (state, & d)))
+                break;
+
+            held.resize (offset + stored_channels * d.output_frames_gen);
+
+            if (! d.output_frames_gen)
+                break;
+        }
+
+        if (error || (error = src_reset (state)))
+            RESAMPLE_ERROR (error);
+    }
+}
+
+static void clear_cache ()
 {
-    if (state)
+    for (CachedState & entry : cache)
     {
-        src_delete (state);
-        state = nullptr;
+        if (entry.state)
+            src_delete (entry.state);
+
+        entry = CachedState ();
     }
 
+    state = nullptr;
+}
+
+bool Resampler::init ()
+{
+    aud_config_set_defaults ("resample", defaults);
+    return true;
+}
+
+void Resampler::cleanup ()
+{
+    clear_cache ();
+    polyphase.clear ();
+    buffer.clear ();
+    held.clear ();
+
+    use_polyphase = false;
+}
+
+void Resampler::start (int & channels, int & rate)
+{
     int new_rate = 0;
 
     if (aud_get_bool ("resample", "use-mappings"))
@@ -122,36 +263,98 @@ void Resampler::start (int & channels, int & rate)
 
     new_rate = aud::clamp (new_rate, MIN_RATE, MAX_RATE);
 
-    if (new_rate == rate)
-        return;
-
     int method = aud_get_int ("resample", "method");
-    int error;
+    double new_ratio = (double) new_rate / rate;
 
-    if ((state = src_new (method, channels, & error)) == nullptr)
+    if (new_rate != rate && method == METHOD_POLYPHASE &&
+     ! Polyphase::supported (rate, new_rate))
     {
-        RESAMPLE_ERROR (error);
+        AUDWARN ("No polyphase filter for %d Hz -> %d Hz, using libsamplerate.\n",
+         rate, new_rate);
+        method = SRC_SINC_BEST_QUALITY;
+    }
+
+    /* unless the same converter goes on, drain it before switching */
+    bool same;
+
+    if (new_rate == rate)
+        same = false;
+    else if (method == METHOD_POLYPHASE)
+        same = use_polyphase && polyphase.matches (rate, new_rate, channels);
+    else
+        same = ! use_polyphase && state && state_matches (state, method, channels, new_ratio);
+
+    if (! same)
+        drain_state (new_rate, channels);
+
+    SRC_STATE * previous = state;
+    bool polyphase_active = use_polyphase;
+
+    state = nullptr;
+    use_polyphase = false;
+
+    if (new_rate == rate)
         return;
+
+    if (method == METHOD_POLYPHASE)
+    {
+        /* as with the state cache, keep the history for gapless playback */
+        if (! polyphase_active || ! polyphase.matches (rate, new_rate, channels))
+            polyphase.setup (rate, new_rate, channels);
+
+        use_polyphase = true;
     }
+    else if (! (state = get_state (method, channels, new_ratio, previous)))
+        return;
 
     stored_channels = channels;
-    ratio = (double) new_rate / rate;
+    stored_rate = new_rate;
+    ratio = new_ratio;
     rate = new_rate;
 }
 
 Index<float> & Resampler::resample (Index<float> & data, bool finish)
 {
+    buffer.resize (0);
+
+    /* the end of the last song comes first */
+    if (held.len ())
+    {
+        buffer.insert (held.begin (), 0, held.len ());
+        held.resize (0);
+    }
+
+    if (use_polyphase)
+    {
+        polyphase.process (data.begin (), data.len () / stored_channels, buffer);
+
+        if (finish)
+        {
+            polyphase.drain (buffer);
+            polyphase.reset ();
+        }
+
+        return buffer;
+    }
+
     if (! state || ! data.len ())
-        return data;
+    {
+        if (! buffer.len ())
+            return data;
 
-    buffer.resize ((int) (data.len () * ratio) + 256);
+        buffer.insert (data.begin (), -1, data.len ());
+        return buffer;
+    }
+
+    int offset = buffer.len ();
+    buffer.resize (offset + (int) (data.len () * ratio) + 256);
 
     SRC_DATA d = SRC_DATA ();
 
     d.data_in = data.begin ();
     d.input_frames = data.len () / stored_channels;
-    d.data_out = buffer.begin ();
-    d.output_frames = buffer.len () / stored_channels;
+    d.data_out = & buffer[offset];
+    d.output_frames = (buffer.len () - offset) / stored_channels;
     d.src_ratio = ratio;
     d.end_of_input = finish;
 
@@ -162,7 +365,7 @@ Index<float> & Resampler::resample (Index<float> & data, bool finish)
         return data;
     }
 
-    buffer.resize (stored_channels * d.output_frames_gen);
+    buffer.resize (offset + stored_channels * d.output_frames_gen);
 
     if (finish)
         flush (true);
@@ -176,6 +379,10 @@ bool Resampler::flush (bool force)
     if (state && (error = src_reset (state)))
         RESAMPLE_ERROR (error);
 
+    if (use_polyphase)
+        polyphase.reset ();
+
+    held.resize (0);
     return true;
 }
 
@@ -188,7 +395,8 @@ static const ComboItem method_list[] = {
     ComboItem(N_("Linear interpolation"), SRC_LINEAR),
     ComboItem(N_("Fast sinc interpolation"), SRC_SINC_FASTEST),
     ComboItem(N_("Medium sinc interpolation"), SRC_SINC_MEDIUM_QUALITY),
-    ComboItem(N_("Best sinc interpolation"), SRC_SINC_BEST_QUALITY)
+    ComboItem(N_("Best sinc interpolation"), SRC_SINC_BEST_QUALITY),
+    ComboItem(N_("Polyphase filter (common rates only)"), METHOD_POLYPHASE)
 };
 
 const PreferencesWidget Resampler::widgets[] = {
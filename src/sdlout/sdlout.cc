@@ -28,11 +28,16 @@
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
-#include <libaudcore/ringbuf.h>
 #include <libaudcore/runtime.h>
 
+#include "../dsp-common/cached-setting.h"
+#include "../dsp-common/spsc-ring.h"
+
 #define VOLUME_RANGE 40 /* decibels */
 
+/* how long the playback thread sleeps at a time while the buffer is full */
+#define WAIT_TIME 10 /* milliseconds */
+
 class SDLOutput : public OutputPlugin
 {
 public:
@@ -77,19 +82,28 @@ const char * const SDLOutput::defaults[] = {
  "vol_right", "100",
  nullptr};
 
+/* The callback takes no locks: the buffer is read without one, and the mutex
+ * only guards the flags below, against the other threads. */
 static pthread_mutex_t sdlout_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t sdlout_cond = PTHREAD_COND_INITIALIZER;
+static SpscWaiter waiter;
 
 static volatile int vol_left, vol_right;
 
 static int sdlout_chan, sdlout_rate;
 
-static RingBuf<unsigned char> buffer;
+static SpscRing<unsigned char> buffer;
 
 static bool prebuffer_flag, paused_flag;
 
-static int block_delay;
-static struct timeval block_time;
+static AtomicValue<int> block_delay, block_time;
+
+/* milliseconds, wrapping around; only differences are used */
+static int time_ms ()
+{
+    struct timeval now;
+    gettimeofday (& now, nullptr);
+    return (unsigned) ((int64_t) now.tv_sec * 1000 + now.tv_usec / 1000);
+}
 
 bool SDLOutput::init ()
 {
@@ -163,10 +177,7 @@ static void apply_stereo_volume (unsigned char * data, int len)
 
 static void callback (void * user, unsigned char * buf, int len)
 {
-    pthread_mutex_lock (& sdlout_mutex);
-
-    int copy = aud::min (len, buffer.len ());
-    buffer.move_out (buf, copy);
+    int copy = buffer.read (buf, len);
 
     if (sdlout_chan == 2)
         apply_stereo_volume (buf, copy);
@@ -179,11 +190,8 @@ static void callback (void * user, unsigned char * buf, int len)
     /* At this moment, we know that there is a delay of (at least) the block of
      * data just written.  We save the block size and the current time for
      * estimating the delay later on. */
-    block_delay = aud::rescale (copy / (2 * sdlout_chan), sdlout_rate, 1000);
-    gettimeofday (& block_time, nullptr);
-
-    pthread_cond_broadcast (& sdlout_cond);
-    pthread_mutex_unlock (& sdlout_mutex);
+    block_time.set (time_ms ());
+    block_delay.set (aud::rescale (copy / (2 * sdlout_chan), sdlout_rate, 1000));
 }
 
 bool SDLOutput::open_audio (int format, int rate, int chan, String & error)
@@ -238,65 +246,55 @@ static void check_started ()
 
     AUDDBG ("Starting playback.\n");
     prebuffer_flag = false;
-    block_delay = 0;
+    block_delay.set (0);
     SDL_PauseAudio (0);
 }
 
 void SDLOutput::period_wait ()
 {
-    pthread_mutex_lock (& sdlout_mutex);
-
     while (! buffer.space ())
     {
+        pthread_mutex_lock (& sdlout_mutex);
+
         if (! paused_flag)
             check_started ();
 
-        pthread_cond_wait (& sdlout_cond, & sdlout_mutex);
-    }
+        pthread_mutex_unlock (& sdlout_mutex);
 
-    pthread_mutex_unlock (& sdlout_mutex);
+        waiter.wait (WAIT_TIME);
+    }
 }
 
 int SDLOutput::write_audio (const void * data, int len)
 {
-    pthread_mutex_lock (& sdlout_mutex);
-
-    len = aud::min (len, buffer.space ());
-    buffer.copy_in ((const unsigned char *) data, len);
-
-    pthread_mutex_unlock (& sdlout_mutex);
-    return len;
+    return buffer.write ((const unsigned char *) data, len);
 }
 
 void SDLOutput::drain ()
 {
     AUDDBG ("Draining.\n");
-    pthread_mutex_lock (& sdlout_mutex);
 
+    pthread_mutex_lock (& sdlout_mutex);
     check_started ();
+    pthread_mutex_unlock (& sdlout_mutex);
 
     while (buffer.len ())
-        pthread_cond_wait (& sdlout_cond, & sdlout_mutex);
-
-    pthread_mutex_unlock (& sdlout_mutex);
+        waiter.wait (WAIT_TIME);
 }
 
 int SDLOutput::get_delay ()
 {
-    auto timediff = [] (const timeval & a, const timeval & b) -> int64_t
-        { return 1000 * (int64_t) (b.tv_sec - a.tv_sec) + (b.tv_usec - a.tv_usec) / 1000; };
-
     pthread_mutex_lock (& sdlout_mutex);
 
     int delay = aud::rescale (buffer.len (), 2 * sdlout_chan * sdlout_rate, 1000);
 
     /* Estimate the additional delay of the last block written. */
-    if (! prebuffer_flag && ! paused_flag && block_delay)
-    {
-        struct timeval cur;
-        gettimeofday (& cur, nullptr);
+    int last_delay = block_delay.get ();
 
-        delay += aud::max (block_delay - timediff (block_time, cur), (int64_t) 0);
+    if (! prebuffer_flag && ! paused_flag && last_delay)
+    {
+        int elapsed = (unsigned) time_ms () - (unsigned) block_time.get ();
+        delay += aud::max (last_delay - elapsed, 0);
     }
 
     pthread_mutex_unlock (& sdlout_mutex);
@@ -313,8 +311,8 @@ void SDLOutput::pause (bool pause)
     if (! prebuffer_flag)
         SDL_PauseAudio (pause);
 
-    pthread_cond_broadcast (& sdlout_cond); /* wake up period wait */
     pthread_mutex_unlock (& sdlout_mutex);
+    waiter.wake (); /* wake up period wait */
 }
 
 void SDLOutput::flush ()
@@ -322,10 +320,10 @@ void SDLOutput::flush ()
     AUDDBG ("Seek requested; discarding buffer.\n");
     pthread_mutex_lock (& sdlout_mutex);
 
-    buffer.discard ();
+    buffer.flush ();
 
     prebuffer_flag = true;
 
-    pthread_cond_broadcast (& sdlout_cond); /* wake up period wait */
     pthread_mutex_unlock (& sdlout_mutex);
+    waiter.wake (); /* wake up period wait */
 }
@@ -25,6 +25,9 @@
 
 #include <math.h>
 
+#include "../dsp-common/cached-setting.h"
+#include "../dsp-common/simd.h"
+
 #define MAX_BUFFER_SECS  10
 
 class SilenceRemoval : public EffectPlugin
@@ -63,10 +66,17 @@ const char * const SilenceRemoval::defaults[] = {
     nullptr
 };
 
+static AtomicValue<float> threshold;
+
+static void threshold_changed ()
+{
+    threshold.set (powf (10.0f, aud_get_int ("silence-removal", "threshold") / 20.0f));
+}
+
 const PreferencesWidget SilenceRemoval::widgets[] = {
     WidgetLabel (N_("<b>Silence Removal</b>")),
     WidgetSpin (N_("Threshold:"),
-        WidgetInt ("silence-removal", "threshold"),
+        WidgetInt ("silence-removal", "threshold", threshold_changed),
         {-60, -20, 1, N_("dB")})
 };
 
@@ -80,6 +90,7 @@ static bool initial_silence;
 bool SilenceRemoval::init ()
 {
     aud_config_set_defaults ("silence-removal", defaults);
+    threshold_changed ();
     return true;
 }
 
@@ -93,6 +104,9 @@ void SilenceRemoval::start (int & channels, int & rate)
 {
     buffer.discard ();
     buffer.alloc (channels * rate * MAX_BUFFER_SECS);
+
+    /* reserve room for the saved silence, which is output all at once */
+    output.insert (0, buffer.size ());
     output.resize (0);
 
     current_channels = channels;
@@ -133,21 +147,20 @@ static void buffer_with_overflow (const float * data, int len)
 
 Index<float> & SilenceRemoval::process (Index<float> & data)
 {
-    const int threshold_db = aud_get_int ("silence-removal", "threshold");
-    const float threshold = powf (10.0f, threshold_db / 20.0f);
-
     float * first_sample = nullptr;
     float * last_sample = nullptr;
 
-    for (float & sample : data)
+    /* scan inwards from both ends; in the usual case of a buffer that is not
+     * silent at either end, this stops almost immediately */
+    float limit = threshold.get ();
+    int first = simd_find_above (data.begin (), data.len (), limit);
+
+    if (first >= 0)
     {
-        if (sample > threshold || sample < -threshold)
-        {
-            if (! first_sample)
-                first_sample = & sample;
+        int last = first + simd_rfind_above (& data[first], data.len () - first, limit);
 
-            last_sample = & sample;
-        }
+        first_sample = & data[first];
+        last_sample = & data[last];
     }
 
     first_sample = align_to_frame (data.begin (), first_sample, false);
@@ -163,6 +176,11 @@ Index<float> & SilenceRemoval::process (Index<float> & data)
 
         initial_silence = false;
 
+        /* in the usual case of nothing to remove or save, pass the data
+         * through without copying it */
+        if (! buffer.len () && first_sample == data.begin () && last_sample == data.end ())
+            return data;
+
         /* copy any saved silence from previous call */
         buffer.move_out (output, -1, -1);
 
@@ -20,6 +20,7 @@
  * the use of this software.
  */
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <soxr.h>
 
@@ -31,6 +32,7 @@
 #define MIN_RATE 8000
 #define MAX_RATE 192000
 #define RATE_STEP 50
+#define MAX_THREADS 64
 
 class SoXResampler : public EffectPlugin
 {
@@ -56,6 +58,7 @@ public:
     void start (int & channels, int & rate);
     Index<float> & process (Index<float> & data);
     bool flush (bool force);
+    int adjust_delay (int delay);
 };
 
 EXPORT SoXResampler aud_plugin_instance;
@@ -68,12 +71,13 @@ const char * const SoXResampler::defaults[] = {
     "allow_aliasing", "FALSE",
 #endif
     "use_steep_filter", "FALSE",
+    "threads", "1",
     nullptr
 };
 
 static soxr_t soxr;
 static soxr_error_t error;
-static int stored_channels;
+static int stored_channels, stored_rate;
 static double ratio;
 static Index<float> buffer;
 
@@ -110,7 +114,11 @@ void SoXResampler::start (int & channels, int & rate)
 
     soxr_quality_spec_t q = soxr_quality_spec (recipe, 0);
 
-    soxr = soxr_create (rate, new_rate, channels, & error, nullptr, & q, nullptr);
+    /* soxr splits the work by channel; 0 lets it use all available cores */
+    int threads = aud::clamp (aud_get_int ("soxr", "threads"), 0, MAX_THREADS);
+    soxr_runtime_spec_t r = soxr_runtime_spec (threads);
+
+    soxr = soxr_create (rate, new_rate, channels, & error, nullptr, & q, & r);
 
     if (error)
     {
@@ -119,6 +127,7 @@ void SoXResampler::start (int & channels, int & rate)
     }
 
     stored_channels = channels;
+    stored_rate = new_rate;
     ratio = (double) new_rate / rate;
     rate = new_rate;
 }
@@ -153,6 +162,16 @@ bool SoXResampler::flush (bool force)
     return true;
 }
 
+int SoXResampler::adjust_delay (int delay)
+{
+    /* soxr reports the delay in output frames; it is much lower with the
+     * minimum and intermediate phase responses than with linear phase */
+    if (soxr)
+        delay += aud::rescale<int64_t> (soxr_delay (soxr), stored_rate, 1000);
+
+    return delay;
+}
+
 const char SoXResampler::about[] =
  N_("SoX Resampler Plugin for Audacious\n"
     "Copyright 2013 Michał Lipski\n\n"
@@ -187,7 +206,10 @@ const PreferencesWidget SoXResampler::widgets[] = {
     WidgetCheck (N_("Use steep filter"), WidgetBool ("soxr", "use_steep_filter")),
     WidgetSpin (N_("Rate:"),
         WidgetInt ("soxr", "rate"),
-        {MIN_RATE, MAX_RATE, RATE_STEP, N_("Hz")})
+        {MIN_RATE, MAX_RATE, RATE_STEP, N_("Hz")}),
+    WidgetSpin (N_("Threads:"),
+        WidgetInt ("soxr", "threads"),
+        {0, MAX_THREADS, 1, N_("(0 = automatic)")})
 };
 
 const PluginPreferences SoXResampler::prefs = {{widgets}};
@@ -18,6 +18,8 @@
  */
 
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
 #include <samplerate.h>
 
 #include <libaudcore/hook.h>
@@ -25,6 +27,11 @@
 #include <libaudcore/runtime.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
+#include <libaudcore/ringbuf.h>
+
+#include "../dsp-common/cached-setting.h"
+#include "../dsp-common/fft.h"
+#include "../dsp-common/simd.h"
 
 /* The general idea of the speed change algorithm is to divide the input signal
  * into pieces, spaced at a time interval A, using a cosine-shaped window
@@ -35,6 +42,21 @@
 #define FREQ    10
 #define OVERLAP  3
 
+/* WSOLA (waveform similarity overlap-add) refines this: the pieces are Hann
+ * windows overlapping by half, and each piece is taken not exactly at its
+ * nominal input position but at the nearby offset where the input looks most
+ * like the natural continuation of the previous piece.  Splicing at matching
+ * waveforms avoids the phasing and echo artifacts of plain overlap-add.  The
+ * best offset is found by cross-correlating the mono downmix via FFT. */
+
+#define WSOLA_FREQ 80  /* output pieces per second */
+#define WSOLA_DECIMATE 4  /* resolution of the coarse search, in frames */
+
+enum {
+    METHOD_OLA,
+    METHOD_WSOLA
+};
+
 #define CFGSECT "speed-pitch"
 #define MINSPEED 0.5
 #define MAXSPEED 2.0
@@ -77,14 +99,49 @@ private:
 
 EXPORT SpeedPitch aud_plugin_instance;
 
+static CachedSetting<bool> decouple_setting (CFGSECT, "decouple");
+static CachedSetting<float> speed_setting (CFGSECT, "speed");
+static CachedSetting<float> pitch_setting (CFGSECT, "pitch");
+
 static double semitones;
 static int curchans, currate;
 static SRC_STATE * srcstate;
 static int outstep, width;
 static Index<float> cosine;
-static Index<float> in, out;
+static Index<float> in, out, output;
 static int src, dst;
 
+/* WSOLA state.  Positions are absolute input frames (after pitch adjustment);
+ * the input ring buffer and the circular overlap-add accumulator are allocated
+ * in start(), so pieces are cut and spliced without allocating or moving
+ * memory. */
+static bool wsola;
+static int hop, seek, wlen;           /* frames */
+static Index<float> window;           /* wlen frames, interleaved */
+static RingBuf<float> wsola_in;
+static int64_t in_base;               /* frame at the head of wsola_in */
+static double ana_pos;                /* nominal start of the next piece */
+static int64_t prev_pos;              /* actual start of the previous piece */
+static bool have_prev;
+static Index<float> acc;              /* wlen frames, circular */
+static int acc_ofs;
+static Index<float> scratch, mono;
+static Index<double> energy;
+static FFT fft;
+static Index<FFT::Complex> fft_buf, fft_prod;
+
+/* Grows the capacity of <b> to at least <size> without changing its contents,
+ * so that the buffer does not have to grow during playback. */
+static void reserve (Index<float> & b, int size)
+{
+    int len = b.len ();
+    if (size > len)
+    {
+        b.resize (size);
+        b.resize (len);
+    }
+}
+
 static void add_data (Index<float> & b, Index<float> & data, float ratio)
 {
     int oldlen = b.len ();
@@ -104,6 +161,275 @@ static void add_data (Index<float> & b, Index<float> & data, float ratio)
     b.resize (oldlen + d.output_frames_gen * curchans);
 }
 
+/* Copies <frames> frames starting at input frame <pos> to <dest>, filling in
+ * silence for frames that are not (or no longer) in the input buffer. */
+static void wsola_read (float * dest, int64_t pos, int frames)
+{
+    int avail = wsola_in.len () / curchans;
+    int64_t rel = pos - in_base;
+
+    int before = aud::clamp<int64_t> (-rel, 0, frames);
+    int start = rel + before;
+    int count = aud::clamp (avail - start, 0, frames - before);
+
+    memset (dest, 0, sizeof (float) * before * curchans);
+    dest += before * curchans;
+
+    int from = start * curchans;
+    int len = count * curchans;
+    int linear = wsola_in.linear ();
+
+    if (from < linear)
+    {
+        int part = aud::min (len, linear - from);
+        memcpy (dest, & wsola_in[from], sizeof (float) * part);
+        dest += part;
+        from += part;
+        len -= part;
+    }
+
+    if (len)
+    {
+        memcpy (dest, & wsola_in[from], sizeof (float) * len);
+        dest += len;
+    }
+
+    memset (dest, 0, sizeof (float) * (frames - before - count) * curchans);
+}
+
+static float downmix (const float * frame)
+{
+    float sum = 0;
+    for (int c = 0; c < curchans; c ++)
+        sum += frame[c];
+
+    return sum;
+}
+
+/* Normalized correlation of the target with the search region at <lag>;
+ * normalizing by the energy of the candidate keeps loud passages from winning
+ * just for being loud. */
+static float wsola_score (int lag)
+{
+    const float * search = & mono[lag];
+    const float * target = & mono[hop + 2 * seek];
+
+    float sum = 0;
+    for (int i = 0; i < hop; i ++)
+        sum += search[i] * target[i];
+
+    double e = energy[lag + hop] - energy[lag];
+    return sum / sqrt (aud::max (e, 0.0) + 1e-9);
+}
+
+/* Returns the offset within [-seek, seek] of <pos> at which the input best
+ * matches the continuation of the previous piece over the overlapping half.
+ * A coarse search runs on a decimated downmix, with both real signals packed
+ * into one complex transform and separated again in the frequency domain; the
+ * result is then refined at full resolution. */
+static int wsola_search (int64_t pos)
+{
+    int span = hop + 2 * seek;
+    float * target = & mono[span];
+
+    wsola_read (scratch.begin (), pos - seek, span);
+
+    energy[0] = 0;
+    for (int i = 0; i < span; i ++)
+    {
+        mono[i] = downmix (& scratch[i * curchans]);
+        energy[i + 1] = energy[i] + mono[i] * mono[i];
+    }
+
+    wsola_read (scratch.begin (), prev_pos + hop, hop);
+
+    for (int i = 0; i < hop; i ++)
+        target[i] = downmix (& scratch[i * curchans]);
+
+    int size = fft.size ();
+    FFT::Complex * z = fft_buf.begin ();
+    FFT::Complex * prod = fft_prod.begin ();
+
+    for (int i = 0; i < size; i ++)
+    {
+        float x = 0, y = 0;
+
+        for (int j = i * WSOLA_DECIMATE; j < (i + 1) * WSOLA_DECIMATE; j ++)
+        {
+            if (j < span)
+                x += mono[j];
+            if (j < hop)
+                y += target[j];
+        }
+
+        z[i] = FFT::Complex (x, y);
+    }
+
+    fft.forward (z);
+
+    for (int k = 0; k < size; k ++)
+    {
+        FFT::Complex a = z[k];
+        FFT::Complex b = std::conj (z[(size - k) & (size - 1)]);
+        FFT::Complex search = (a + b) * 0.5f;
+        FFT::Complex target = (a - b) * FFT::Complex (0, -0.5f);
+
+        prod[k] = search * std::conj (target);
+    }
+
+    fft.inverse (prod);
+
+    int coarse = 0;
+    float best_score = -HUGE_VALF;
+
+    for (int i = 0; i * WSOLA_DECIMATE <= 2 * seek; i ++)
+    {
+        int lag = i * WSOLA_DECIMATE;
+        double e = energy[lag + hop] - energy[lag];
+        float score = prod[i].real () / sqrt (aud::max (e, 0.0) + 1e-9);
+
+        if (score > best_score)
+        {
+            coarse = lag;
+            best_score = score;
+        }
+    }
+
+    int best = coarse;
+    best_score = -HUGE_VALF;
+
+    int first = aud::max (coarse - WSOLA_DECIMATE + 1, 0);
+    int last = aud::min (coarse + WSOLA_DECIMATE - 1, 2 * seek);
+
+    for (int lag = first; lag <= last; lag ++)
+    {
+        float score = wsola_score (lag);
+
+        if (score > best_score)
+        {
+            best = lag;
+            best_score = score;
+        }
+    }
+
+    return best - seek;
+}
+
+/* Adds one windowed piece of input to the accumulator and emits the part of the
+ * accumulator that no later piece will overlap. */
+static void wsola_step (Index<float> & output, int64_t pos)
+{
+    if (have_prev)
+        pos += wsola_search (pos);
+
+    float * piece = scratch.begin ();
+    wsola_read (piece, pos, wlen);
+
+    int samples = wlen * curchans;
+    int part = samples - acc_ofs;
+
+    simd_mix_mul (& acc[acc_ofs], piece, window.begin (), part);
+    simd_mix_mul (acc.begin (), piece + part, & window[part], samples - part);
+
+    int done = hop * curchans;
+    part = aud::min (done, samples - acc_ofs);
+
+    /* the very first piece only fades in; its first half is not output */
+    if (have_prev)
+    {
+        float * dest = output.insert (-1, done);
+        memcpy (dest, & acc[acc_ofs], sizeof (float) * part);
+        memcpy (dest + part, acc.begin (), sizeof (float) * (done - part));
+    }
+
+    memset (& acc[acc_ofs], 0, sizeof (float) * part);
+    memset (acc.begin (), 0, sizeof (float) * (done - part));
+    acc_ofs = (acc_ofs + done) % samples;
+
+    prev_pos = pos;
+    have_prev = true;
+}
+
+static void wsola_reset ()
+{
+    wsola_in.discard ();
+    in_base = 0;
+
+    /* center the first piece on the start so that it need not fade in */
+    ana_pos = -hop;
+    prev_pos = 0;
+    have_prev = false;
+
+    acc.erase (0, -1);
+    acc_ofs = 0;
+}
+
+/* Consumes the pitch-adjusted input in <in> and replaces the contents of <data>
+ * with the time-stretched output.  <stretch> is the ratio of input to output
+ * time. */
+static void wsola_process (Index<float> & data, double stretch, bool ending)
+{
+    double ana_hop = hop * stretch;
+    int total = in.len ();
+    int consumed = 0;
+
+    data.resize (0);
+
+    while (1)
+    {
+        int count = aud::min (total - consumed, wsola_in.space ());
+        wsola_in.copy_in (& in[consumed], count);
+        consumed += count;
+
+        bool last = ending && consumed == total;
+        int64_t in_end = in_base + wsola_in.len () / curchans;
+
+        while (1)
+        {
+            int64_t pos = (int64_t) llround (ana_pos);
+
+            /* wait for the search region and the previous piece's continuation
+             * to be complete, unless there is no more input coming */
+            int64_t need = pos + seek + wlen;
+            if (have_prev)
+                need = aud::max (need, prev_pos + hop * 2);
+
+            if (last ? pos + hop >= in_end : need > in_end)
+                break;
+
+            wsola_step (data, pos);
+            ana_pos += ana_hop;
+
+            /* discard input that no later piece can read */
+            int64_t keep = aud::min ((int64_t) llround (ana_pos) - seek, prev_pos + hop);
+            int64_t drop = aud::clamp<int64_t> (keep - in_base, 0, in_end - in_base);
+
+            wsola_in.discard (drop * curchans);
+            in_base += drop;
+        }
+
+        if (consumed == total)
+            break;
+    }
+
+    in.resize (0);
+
+    if (ending)
+    {
+        /* emit the fade-out of the last piece, up to the end of the input */
+        int64_t in_end = in_base + wsola_in.len () / curchans;
+        int samples = wlen * curchans;
+        int rest = aud::clamp<int64_t> (in_end - (prev_pos + hop), 0, wlen - hop) * curchans;
+        int part = aud::min (rest, samples - acc_ofs);
+
+        float * dest = data.insert (-1, rest);
+        memcpy (dest, & acc[acc_ofs], sizeof (float) * part);
+        memcpy (dest + part, acc.begin (), sizeof (float) * (rest - part));
+
+        wsola_reset ();
+    }
+}
+
 bool SpeedPitch::flush (bool force)
 {
     src_reset (srcstate);
@@ -119,6 +445,9 @@ bool SpeedPitch::flush (bool force)
      * the width of a cosine window. */
     out.insert (0, width / 2);
 
+    if (wsola)
+        wsola_reset ();
+
     return true;
 }
 
@@ -144,24 +473,72 @@ void SpeedPitch::start (int & chans, int & rate)
     for (int i = 0; i < width; i ++)
         cosine[i] = (1.0 - cos (2.0 * M_PI * i / width)) / OVERLAP;
 
+    /* Leave room for a half-second chunk of input at any speed and pitch. */
+    int size = width + curchans * currate;
+    reserve (in, size);
+    reserve (out, size);
+    reserve (output, size);
+
+    wsola = (aud_get_int (CFGSECT, "method") == METHOD_WSOLA);
+
+    if (wsola)
+    {
+        hop = currate / WSOLA_FREQ;
+        wlen = hop * 2;
+
+        /* search as far as the transform size needed anyway allows */
+        int size = FFT::size_for (hop * 3 / 2);
+        seek = aud::min ((size - hop) / 2, hop);
+        fft.init (size / WSOLA_DECIMATE);
+
+        /* a periodic Hann window sums to unity at half overlap */
+        window.resize (wlen * curchans);
+        for (int i = 0; i < wlen; i ++)
+        {
+            float w = 0.5 - 0.5 * cos (2.0 * M_PI * i / wlen);
+            for (int c = 0; c < curchans; c ++)
+                window[i * curchans + c] = w;
+        }
+
+        int span = hop + 2 * seek;
+        fft_buf.resize (fft.size ());
+        fft_prod.resize (fft.size ());
+        energy.resize (span + 1);
+        mono.resize (span + hop);
+        scratch.resize (aud::max (span, wlen) * curchans);
+        acc.resize (wlen * curchans);
+
+        /* room for the pieces still to be read plus a good chunk of new input */
+        wsola_in.alloc ((5 * wlen + span) * curchans);
+    }
+
     flush (true);
 }
 
 Index<float> & SpeedPitch::process (Index<float> & data, bool ending)
 {
     const float * cosine_center = & cosine[width / 2];
-    float pitch = aud_get_double (CFGSECT, "pitch");
-    float speed = aud_get_double (CFGSECT, "speed");
+    float pitch = pitch_setting.get ();
+    float speed = speed_setting.get ();
 
     /* Copy the passed audio to the input buffer, scaled to adjust pitch. */
     add_data (in, data, 1.0 / pitch);
 
-    if (! aud_get_bool (CFGSECT, "decouple"))
+    /* Swap the buffers rather than moving one into the other, so that both
+     * keep their storage and neither has to be allocated again. */
+    if (! decouple_setting.get ())
     {
-        data = std::move (in);
+        std::swap (data, in);
+        in.resize (0);
         return data;
     }
 
+    if (wsola)
+    {
+        wsola_process (output, speed / pitch, ending);
+        return output;
+    }
+
     /* Calculate the spacing interval for input. */
     int instep = (int) round ((outstep / curchans) * speed / pitch) * curchans;
 
@@ -190,30 +567,44 @@ Index<float> & SpeedPitch::process (Index<float> & data, bool ending)
     in.remove (0, seek);
     src -= seek;
 
-    data.resize (0);
+    output.resize (0);
 
     /* Return output up to half a window's width before the destination pointer
      * (or right up to the previous destination pointer if the song is ending). */
     int ret = aud::clamp (0, dst - (ending ? outstep : width / 2), out.len ());
-    data.move_from (out, 0, 0, ret, true, true);
+    output.move_from (out, 0, 0, ret, true, true);
     dst -= ret;
 
-    return data;
+    return output;
 }
 
 int SpeedPitch::adjust_delay (int delay)
 {
-    if (! aud_get_bool (CFGSECT, "decouple"))
+    if (! decouple_setting.get ())
         return delay;
 
     float samples_to_ms = 1000.0 / (curchans * currate);
-    float speed = aud_get_double (CFGSECT, "speed");
+    float speed = speed_setting.get ();
     int in_samples = in.len () - src;
     int out_samples = dst;
 
+    if (wsola)
+    {
+        int64_t in_end = in_base + wsola_in.len () / curchans;
+        in_samples = aud::max<int64_t> (in_end - (int64_t) llround (ana_pos), 0) * curchans;
+        out_samples = (wlen - hop) * curchans;
+    }
+
     return (delay + in_samples * samples_to_ms) * speed + out_samples * samples_to_ms;
 }
 
+static void update_settings ()
+{
+    decouple_setting.update ();
+    speed_setting.update ();
+    pitch_setting.update ();
+}
+
 static void sync_speed ()
 {
     if (! aud_get_bool (CFGSECT, "decouple"))
@@ -221,6 +612,8 @@ static void sync_speed ()
         aud_set_double (CFGSECT, "speed", aud_get_double (CFGSECT, "pitch"));
         hook_call ("speed-pitch set speed", nullptr);
     }
+
+    update_settings ();
 }
 
 static void pitch_changed ()
@@ -241,16 +634,26 @@ const char * const SpeedPitch::defaults[] = {
  "decouple", "TRUE",
  "speed", "1",
  "pitch", "1",
+ "method", "0",
  nullptr};
 
+static const ComboItem method_list[] = {
+    ComboItem (N_("Overlap-add"), METHOD_OLA),
+    ComboItem (N_("WSOLA (better quality)"), METHOD_WSOLA)
+};
+
 const PreferencesWidget SpeedPitch::widgets[] = {
     WidgetLabel (N_("<b>Speed</b>")),
     WidgetCheck (N_("Decouple from pitch"),
         WidgetBool (CFGSECT, "decouple", sync_speed)),
     WidgetSpin (N_("Multiplier:"),
-        WidgetFloat (CFGSECT, "speed", nullptr, "speed-pitch set speed"),
+        WidgetFloat (CFGSECT, "speed", update_settings, "speed-pitch set speed"),
         {MINSPEED, MAXSPEED, 0.05},
         WIDGET_CHILD),
+    WidgetCombo (N_("Method:"),
+        WidgetInt (CFGSECT, "method"),
+        {{method_list}},
+        WIDGET_CHILD),
     WidgetLabel (N_("<b>Pitch</b>")),
     WidgetSpin (nullptr,
         WidgetFloat (semitones, semitones_changed, "speed-pitch set semitones"),
@@ -280,4 +683,15 @@ void SpeedPitch::cleanup ()
     cosine.clear ();
     in.clear ();
     out.clear ();
+    output.clear ();
+
+    window.clear ();
+    wsola_in.destroy ();
+    acc.clear ();
+    scratch.clear ();
+    mono.clear ();
+    energy.clear ();
+    fft.clear ();
+    fft_buf.clear ();
+    fft_prod.clear ();
 }
@@ -0,0 +1,373 @@
+/*
+ * Combined Stereo Effects Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+/* Runs Extra Stereo, Voice Removal, Crystalizer and BS2B crossfeed in a single
+ * pass over each buffer, instead of one pass per plugin.  The first three are
+ * linear and time-invariant, so chained together they reduce to one filter:
+ *
+ *   out[n] = A * in[n] + B * in[n - 1]
+ *
+ * where A and B are 2x2 matrices.  BS2B is fed from the same pass in chunks
+ * small enough to stay in cache.  The settings are shared with the standalone
+ * plugins, which should not be enabled at the same time. */
+
+#include <libaudcore/hook.h>
+#include <libaudcore/i18n.h>
+#include <libaudcore/runtime.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+
+#ifdef HAVE_BS2B
+#include <bs2b.h>
+#endif
+
+#include "../dsp-common/cached-setting.h"
+#include "../dsp-common/simd.h"
+
+#define CHUNK_FRAMES 256
+
+class StereoEffects : public EffectPlugin
+{
+public:
+    static const char about[];
+    static const PreferencesWidget widgets[];
+    static const PluginPreferences prefs;
+
+    static constexpr PluginInfo info = {
+        N_("Combined Stereo Effects"),
+        PACKAGE,
+        about,
+        & prefs
+    };
+
+    constexpr StereoEffects () : EffectPlugin (info, 0, true) {}
+
+    bool init ();
+    void cleanup ();
+
+    void start (int & channels, int & rate);
+    Index<float> & process (Index<float> & data);
+    bool flush (bool force);
+};
+
+EXPORT StereoEffects aud_plugin_instance;
+
+static const char * const stereo_fx_defaults[] = {
+ "extra_stereo", "FALSE",
+ "voice_removal", "FALSE",
+ "crystalizer", "FALSE",
+ "bs2b", "FALSE",
+ nullptr};
+
+/* same as in the standalone plugins */
+static const char * const extra_stereo_defaults[] = {
+ "intensity", "2.5",
+ nullptr};
+
+static const char * const crystalizer_defaults[] = {
+ "intensity", "1",
+ nullptr};
+
+#ifdef HAVE_BS2B
+static const char * const bs2b_defaults[] = {
+ "feed", "45",
+ "fcut", "700",
+ nullptr};
+
+static t_bs2bdp bs2b;
+static bool use_bs2b;
+static int applied_feed, applied_fcut;
+#endif
+
+/* changed by the main thread, applied by the audio thread */
+static CachedSetting<bool> extra_stereo_setting ("stereo_fx", "extra_stereo");
+static CachedSetting<bool> voice_removal_setting ("stereo_fx", "voice_removal");
+static CachedSetting<bool> crystalizer_setting ("stereo_fx", "crystalizer");
+static CachedSetting<float> extra_stereo_level ("extra_stereo", "intensity");
+static CachedSetting<float> crystalizer_level ("crystalizer", "intensity");
+
+#ifdef HAVE_BS2B
+static CachedSetting<bool> bs2b_setting ("stereo_fx", "bs2b");
+static CachedSetting<int> feed_level ("bs2b", "feed");
+static CachedSetting<int> fcut_level ("bs2b", "fcut");
+#endif
+
+static int fx_channels;
+static bool use_filter, use_crystalizer;
+static float filter_a[4], filter_b[4];
+static float crystalizer_value;
+static Index<float> prev_frame;
+
+static void update_settings ()
+{
+    extra_stereo_setting.update ();
+    voice_removal_setting.update ();
+    crystalizer_setting.update ();
+
+#ifdef HAVE_BS2B
+    bs2b_setting.update ();
+#endif
+}
+
+/* The levels are shared with the standalone plugins, so changes to them are
+ * announced through hooks that both sides listen to. */
+static void reload_extra_stereo (void *, void *)
+    { extra_stereo_level.update (); }
+static void reload_crystalizer (void *, void *)
+    { crystalizer_level.update (); }
+
+static void extra_stereo_changed ()
+    { hook_call ("extra_stereo settings changed", nullptr); }
+static void crystalizer_changed ()
+    { hook_call ("crystalizer settings changed", nullptr); }
+
+#ifdef HAVE_BS2B
+static void reload_bs2b (void *, void *)
+{
+    feed_level.update ();
+    fcut_level.update ();
+}
+
+static void bs2b_changed ()
+    { hook_call ("bs2b settings changed", nullptr); }
+#endif
+
+/* The filter is worked out again by the audio thread from the cached settings,
+ * so that it never sees a half-updated matrix. */
+static void apply_settings ()
+{
+    bool extra_stereo = extra_stereo_setting.get ();
+    bool voice_removal = voice_removal_setting.get ();
+    use_crystalizer = crystalizer_setting.get ();
+
+    float m[4] = {1, 0, 0, 1};
+
+    /* left = center + (left - center) * intensity, likewise for right */
+    if (extra_stereo)
+    {
+        float value = extra_stereo_level.get ();
+        m[0] = m[3] = (1 + value) / 2;
+        m[1] = m[2] = (1 - value) / 2;
+    }
+
+    /* left = right = left - right */
+    if (voice_removal)
+    {
+        float left = m[0] - m[2];
+        float right = m[1] - m[3];
+        m[0] = m[2] = left;
+        m[1] = m[3] = right;
+    }
+
+    /* out = in + (in - prev) * intensity */
+    crystalizer_value = use_crystalizer ? crystalizer_level.get () : 0;
+
+    for (int i = 0; i < 4; i ++)
+    {
+        filter_a[i] = (1 + crystalizer_value) * m[i];
+        filter_b[i] = -crystalizer_value * m[i];
+    }
+
+    use_filter = (extra_stereo || voice_removal || use_crystalizer);
+
+#ifdef HAVE_BS2B
+    use_bs2b = (bs2b && bs2b_setting.get ());
+
+    if (use_bs2b)
+    {
+        int new_feed = feed_level.get ();
+        int new_fcut = fcut_level.get ();
+
+        if (new_feed != applied_feed)
+            bs2b_set_level_feed (bs2b, (applied_feed = new_feed));
+        if (new_fcut != applied_fcut)
+            bs2b_set_level_fcut (bs2b, (applied_fcut = new_fcut));
+    }
+#endif
+}
+
+bool StereoEffects::init ()
+{
+    aud_config_set_defaults ("stereo_fx", stereo_fx_defaults);
+    aud_config_set_defaults ("extra_stereo", extra_stereo_defaults);
+    aud_config_set_defaults ("crystalizer", crystalizer_defaults);
+
+#ifdef HAVE_BS2B
+    aud_config_set_defaults ("bs2b", bs2b_defaults);
+
+    if (! (bs2b = bs2b_open ()))
+        AUDERR ("Failed to open BS2B, crossfeed is disabled.\n");
+
+    applied_feed = applied_fcut = 0;
+#endif
+
+    update_settings ();
+    reload_extra_stereo (nullptr, nullptr);
+    reload_crystalizer (nullptr, nullptr);
+
+    hook_associate ("extra_stereo settings changed", reload_extra_stereo, nullptr);
+    hook_associate ("crystalizer settings changed", reload_crystalizer, nullptr);
+
+#ifdef HAVE_BS2B
+    reload_bs2b (nullptr, nullptr);
+    hook_associate ("bs2b settings changed", reload_bs2b, nullptr);
+#endif
+
+    apply_settings ();
+    return true;
+}
+
+void StereoEffects::cleanup ()
+{
+    hook_dissociate ("extra_stereo settings changed", reload_extra_stereo);
+    hook_dissociate ("crystalizer settings changed", reload_crystalizer);
+
+#ifdef HAVE_BS2B
+    hook_dissociate ("bs2b settings changed", reload_bs2b);
+
+    if (bs2b)
+        bs2b_close (bs2b);
+
+    bs2b = nullptr;
+#endif
+
+    prev_frame.clear ();
+}
+
+void StereoEffects::start (int & channels, int & rate)
+{
+    fx_channels = channels;
+    prev_frame.resize (channels);
+    prev_frame.erase (0, channels);
+
+#ifdef HAVE_BS2B
+    if (bs2b)
+    {
+        bs2b_set_srate (bs2b, rate);
+        bs2b_clear (bs2b);
+    }
+#endif
+
+    apply_settings ();
+}
+
+/* only the crystalizer applies to other than stereo */
+static void crystalize (Index<float> & data)
+{
+    float * f = data.begin ();
+    float * end = data.end ();
+
+    while (f < end)
+    {
+        for (int channel = 0; channel < fx_channels; channel ++)
+        {
+            float current = * f;
+            * f ++ = current + (current - prev_frame[channel]) * crystalizer_value;
+            prev_frame[channel] = current;
+        }
+    }
+}
+
+Index<float> & StereoEffects::process (Index<float> & data)
+{
+    apply_settings ();
+
+    if (fx_channels != 2)
+    {
+        if (use_crystalizer)
+            crystalize (data);
+
+        return data;
+    }
+
+    float * f = data.begin ();
+    int frames = data.len () / 2;
+
+#ifdef HAVE_BS2B
+    if (use_bs2b)
+    {
+        for (int n = 0; n < frames; n += CHUNK_FRAMES)
+        {
+            int chunk = aud::min (frames - n, CHUNK_FRAMES);
+
+            if (use_filter)
+                simd_stereo_fir (f + 2 * n, chunk, filter_a, filter_b, prev_frame.begin ());
+
+            bs2b_cross_feed_f (bs2b, f + 2 * n, chunk);
+        }
+
+        return data;
+    }
+#endif
+
+    if (use_filter)
+        simd_stereo_fir (f, frames, filter_a, filter_b, prev_frame.begin ());
+
+    return data;
+}
+
+bool StereoEffects::flush (bool force)
+{
+    prev_frame.erase (0, fx_channels);
+
+#ifdef HAVE_BS2B
+    if (bs2b)
+        bs2b_clear (bs2b);
+#endif
+
+    return true;
+}
+
+const char StereoEffects::about[] =
+ N_("Combined Stereo Effects Plugin for Audacious\n"
+    "Copyright 2026 Audacious developers\n\n"
+    "Applies Extra Stereo, Voice Removal, Crystalizer and BS2B crossfeed "
+    "in a single pass.  Use it instead of the separate plugins.");
+
+const PreferencesWidget StereoEffects::widgets[] = {
+    WidgetLabel (N_("<b>Effects</b>")),
+    WidgetCheck (N_("Extra stereo"),
+        WidgetBool ("stereo_fx", "extra_stereo", update_settings)),
+    WidgetSpin (N_("Intensity:"),
+        WidgetFloat ("extra_stereo", "intensity", extra_stereo_changed),
+        {0, 10, 0.1},
+        WIDGET_CHILD),
+    WidgetCheck (N_("Voice removal"),
+        WidgetBool ("stereo_fx", "voice_removal", update_settings)),
+    WidgetCheck (N_("Crystalizer"),
+        WidgetBool ("stereo_fx", "crystalizer", update_settings)),
+    WidgetSpin (N_("Intensity:"),
+        WidgetFloat ("crystalizer", "intensity", crystalizer_changed),
+        {0, 10, 0.1},
+        WIDGET_CHILD),
+#ifdef HAVE_BS2B
+    WidgetCheck (N_("BS2B crossfeed"),
+        WidgetBool ("stereo_fx", "bs2b", update_settings)),
+    WidgetSpin (N_("Feed level:"),
+        WidgetInt ("bs2b", "feed", bs2b_changed, "bs2b preset loaded"),
+        {BS2B_MINFEED, BS2B_MAXFEED, 1, N_("x1/10 dB")},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Cut frequency:"),
+        WidgetInt ("bs2b", "fcut", bs2b_changed, "bs2b preset loaded"),
+        {BS2B_MINFCUT, BS2B_MAXFCUT, 1, N_("Hz")},
+        WIDGET_CHILD)
+#endif
+};
+
+const PluginPreferences StereoEffects::prefs = {{widgets}};
@@ -2,11 +2,14 @@
  * Written by Johan Levin, 1999
  * Modified by John Lindgren, 2009-2012 */
 
+#include <libaudcore/hook.h>
 #include <libaudcore/i18n.h>
 #include <libaudcore/runtime.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../dsp-common/cached-setting.h"
+
 class ExtraStereo : public EffectPlugin
 {
 public:
@@ -25,6 +28,7 @@ public:
     constexpr ExtraStereo () : EffectPlugin (info, 0, true) {}
 
     bool init ();
+    void cleanup ();
 
     void start (int & channels, int & rate);
     Index<float> & process (Index<float> & data);
@@ -40,10 +44,23 @@ const char * const ExtraStereo::defaults[] = {
  "intensity", "2.5",
  nullptr};
 
+static CachedSetting<float> intensity ("extra_stereo", "intensity");
+
+/* the intensity is shared with the Stereo Effects plugin */
+static void intensity_changed ()
+{
+    hook_call ("extra_stereo settings changed", nullptr);
+}
+
+static void reload_intensity (void *, void *)
+{
+    intensity.update ();
+}
+
 const PreferencesWidget ExtraStereo::widgets[] = {
     WidgetLabel (N_("<b>Extra Stereo</b>")),
     WidgetSpin (N_("Intensity:"),
-        WidgetFloat ("extra_stereo", "intensity"),
+        WidgetFloat ("extra_stereo", "intensity", intensity_changed),
         {0, 10, 0.1})
 };
 
@@ -52,9 +69,16 @@ const PluginPreferences ExtraStereo::prefs = {{widgets}};
 bool ExtraStereo::init ()
 {
     aud_config_set_defaults ("extra_stereo", defaults);
+    intensity.update ();
+    hook_associate ("extra_stereo settings changed", reload_intensity, nullptr);
     return true;
 }
 
+void ExtraStereo::cleanup ()
+{
+    hook_dissociate ("extra_stereo settings changed", reload_intensity);
+}
+
 static int stereo_channels;
 
 void ExtraStereo::start (int & channels, int & rate)
@@ -64,7 +88,7 @@ void ExtraStereo::start (int & channels, int & rate)
 
 Index<float> & ExtraStereo::process(Index<float> & data)
 {
-    float value = aud_get_double ("extra_stereo", "intensity");
+    float value = intensity.get ();
     float * f, * end;
     float center;
 
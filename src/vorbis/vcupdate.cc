@@ -85,6 +85,19 @@ static void insert_int_tuple_field_to_dictionary (const Tuple & tuple,
         dict.remove (String (key));
 }
 
+/* ReplayGain values are read from the comments at playback time rather than
+ * into the tuple, so they are only replaced, never removed. */
+static void insert_gain_tuple_field_to_dictionary (const Tuple & tuple,
+ Tuple::Field field, Tuple::Field unit_field, Dictionary & dict,
+ const char * key, const char * suffix)
+{
+    int unit = tuple.get_int (unit_field);
+
+    if (tuple.get_value_type (field) == Tuple::Int && unit > 0)
+        dict.add (String (key), String (str_concat ({double_to_str
+         (tuple.get_int (field) / (double) unit), suffix})));
+}
+
 bool VorbisPlugin::write_tuple (const char * filename, VFSFile & file, const Tuple & tuple)
 {
     VCEdit edit;
@@ -103,6 +116,15 @@ bool VorbisPlugin::write_tuple (const char * filename, VFSFile & file, const Tup
     insert_int_tuple_field_to_dictionary (tuple, Tuple::Year, dict, "DATE");
     insert_int_tuple_field_to_dictionary (tuple, Tuple::Track, dict, "TRACKNUMBER");
 
+    insert_gain_tuple_field_to_dictionary (tuple, Tuple::TrackGain,
+     Tuple::GainDivisor, dict, "REPLAYGAIN_TRACK_GAIN", " dB");
+    insert_gain_tuple_field_to_dictionary (tuple, Tuple::TrackPeak,
+     Tuple::PeakDivisor, dict, "REPLAYGAIN_TRACK_PEAK", "");
+    insert_gain_tuple_field_to_dictionary (tuple, Tuple::AlbumGain,
+     Tuple::GainDivisor, dict, "REPLAYGAIN_ALBUM_GAIN", " dB");
+    insert_gain_tuple_field_to_dictionary (tuple, Tuple::AlbumPeak,
+     Tuple::PeakDivisor, dict, "REPLAYGAIN_ALBUM_PEAK", "");
+
     dictionary_to_vorbis_comment (& edit.vc, dict);
 
     auto temp_vfs = VFSFile::tmpfile ();
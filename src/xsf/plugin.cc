@@ -34,6 +34,8 @@
 #include <libaudcore/audstrings.h>
 #include <libaudcore/runtime.h>
 
+#include "../dsp-common/cached-setting.h"
+
 #include "ao.h"
 #include "corlett.h"
 #include "vio2sf.h"
@@ -76,9 +78,18 @@ const char* const XSFPlugin::defaults[] =
 	nullptr
 };
 
+/* checked after every segment in the play loop */
+static CachedSetting<bool> ignore_length(CFG_ID, "ignore_length");
+
+static void ignore_length_changed()
+{
+	ignore_length.update();
+}
+
 bool XSFPlugin::init()
 {
 	aud_config_set_defaults(CFG_ID, defaults);
+	ignore_length.update();
 	return true;
 }
 
@@ -118,8 +129,7 @@ static int xsf_get_length(const Index<char> &buf)
 	if (corlett_decode((uint8_t *)buf.begin(), buf.len(), nullptr, nullptr, &c) != AO_SUCCESS)
 		return -1;
 
-	bool ignore_length = aud_get_bool(CFG_ID, "ignore_length");
-	int length = (!ignore_length) ? psfTimeToMS(c->inf_length) + psfTimeToMS(c->inf_fade) : -1;
+	int length = (!ignore_length.get()) ? psfTimeToMS(c->inf_length) + psfTimeToMS(c->inf_fade) : -1;
 
 	free(c);
 
@@ -199,8 +209,7 @@ bool XSFPlugin::play(const char *filename, VFSFile &file)
 
 		write_audio(samples, seglen * 4);
 
-		bool ignore_length = aud_get_bool(CFG_ID, "ignore_length");
-		if (pos >= length && !ignore_length)
+		if (pos >= length && !ignore_length.get())
 			goto CLEANUP;
 	}
 
@@ -229,7 +238,7 @@ const char *const XSFPlugin::exts[] = { "2sf", "mini2sf", nullptr };
 
 const PreferencesWidget XSFPlugin::widgets[] = {
 	WidgetLabel(N_("<b>XSF Configuration</b>")),
-	WidgetCheck(N_("Ignore length from file"), WidgetBool(CFG_ID, "ignore_length")),
+	WidgetCheck(N_("Ignore length from file"), WidgetBool(CFG_ID, "ignore_length", ignore_length_changed)),
 };
 
 const PluginPreferences XSFPlugin::prefs = {{widgets}};